@@ -528,6 +528,8 @@ uint16_t block_palette[] = { ${Object.values(itemsAndBlocks.palette).join(", ")}
 const uint8_t network_block_palette[] = {
 ${toCArray(networkBlockPalette)}
 };
+// Block names, without namespace
+const char *const block_names[] = { ${Object.keys(itemsAndBlocks.palette).map(c => `"${c}"`).join(", ")} };
 
 // Block-to-item mapping
 uint16_t B_to_I[] = { ${itemsAndBlocks.mappingWithOverrides.join(", ")} };
@@ -553,6 +555,7 @@ extern const uint8_t tags_bin[${tagBuffer.length}];
 
 extern uint16_t block_palette[256]; // Block palette
 extern const uint8_t network_block_palette[${networkBlockPalette.length}]; // Block palette as VarInt buffer
+extern const char *const block_names[${Object.keys(itemsAndBlocks.palette).length}]; // Block names
 extern uint16_t B_to_I[256]; // Block-to-item mapping
 uint8_t I_to_B (uint16_t item); // Item-to-block mapping
 
@@ -0,0 +1,24 @@
+#ifndef H_CHUNKJOBS
+#define H_CHUNKJOBS
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "globals.h"
+
+#ifdef USE_CHUNK_JOBS
+  int requestChunkJob (int x, int z);
+  int prefetchChunkJob (int x, int z);
+  uint8_t isChunkJobReady (int x, int z);
+  uint8_t *takeChunkJobBody (int x, int z, size_t *length);
+  void collectChunkJobs ();
+#else
+  // Define no-op placeholders for when chunks are generated inline
+  #define requestChunkJob(x, z) 0
+  #define prefetchChunkJob(x, z) 1
+  #define isChunkJobReady(x, z) true
+  #define takeChunkJobBody(x, z, length) NULL
+  #define collectChunkJobs()
+#endif
+
+#endif
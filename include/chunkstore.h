@@ -0,0 +1,23 @@
+#ifndef H_CHUNKSTORE
+#define H_CHUNKSTORE
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "globals.h"
+
+#ifdef USE_CHUNK_STORE
+  int runChunkPregen (int radius);
+  const uint8_t *getStoredChunkBody (int x, int z, size_t *length);
+#else
+  // Define no-op placeholders for when the chunk store isn't available
+  #define runChunkPregen(radius) 1
+  static inline const uint8_t *getStoredChunkBody (int x, int z, size_t *length) {
+    (void)x;
+    (void)z;
+    (void)length;
+    return NULL;
+  }
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef H_CHUNKVIEW
+#define H_CHUNKVIEW
+
+#include "globals.h"
+
+void clearChunkView (PlayerData *player);
+void startChunkView (PlayerData *player, short center_x, short center_z);
+int recenterChunkView (PlayerData *player, short center_x, short center_z);
+void trackChunkViewMotion (PlayerData *player);
+int sendQueuedChunks (PlayerData *player, int budget);
+void sendChunkNow (PlayerData *player, int x, int z);
+void setChunkViewDistance (PlayerData *player, int requested);
+int getChunkViewDistance (PlayerData *player);
+int getSimulationDistance (PlayerData *player);
+uint8_t isChunkInView (PlayerData *player, int x, int z);
+uint8_t isChunkSimulated (int x, int z);
+uint8_t isMobTracked (PlayerData *player, int mob_index);
+void setMobTracked (PlayerData *player, int mob_index, uint8_t tracked);
+void handleChunkBatchReceived (PlayerData *player, float desired_rate);
+void drainChunkQueues ();
+void updateViewGovernor (int64_t tick_duration);
+
+#endif
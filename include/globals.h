@@ -51,11 +51,50 @@
   #define VIEW_DISTANCE 8
 #endif
 
+// Distance in chunks around players within which mobs, fluids and
+// spawning are simulated. Capped by each player's view distance.
+#ifndef SIMULATION_DISTANCE
+  #define SIMULATION_DISTANCE 4
+#endif
+
+// Upper bound for the view distance, sizes per-player chunk view state
+#ifndef MAX_VIEW_DISTANCE
+  #define MAX_VIEW_DISTANCE 16
+#endif
+
 // Tick interval in microseconds (default 1s).
 #ifndef TIME_BETWEEN_TICKS
   #define TIME_BETWEEN_TICKS 1000000
 #endif
 
+// Interval between chunk send steps in microseconds (one client tick).
+#ifndef CHUNK_SEND_INTERVAL
+  #define CHUNK_SEND_INTERVAL 50000
+#endif
+
+// Chunks sent per send step, shared by all players.
+#ifndef CHUNK_SEND_BUDGET
+  #define CHUNK_SEND_BUDGET 4
+#endif
+
+// How far ahead a moving player's position is predicted to prefetch
+// chunks they are about to need, in microseconds.
+#ifndef CHUNK_PREFETCH_LOOKAHEAD
+  #define CHUNK_PREFETCH_LOOKAHEAD 3000000
+#endif
+
+// Pending outbound bytes of any one player above which the view
+// distance governor considers the network overloaded.
+#ifndef VIEW_GOVERNOR_BACKLOG
+  #define VIEW_GOVERNOR_BACKLOG 262144
+#endif
+
+// Sustained headroom needed before the view distance governor sends
+// chunks one step further out again, in microseconds.
+#ifndef VIEW_GOVERNOR_RESTORE_TIME
+  #define VIEW_GOVERNOR_RESTORE_TIME 10000000
+#endif
+
 // Average passive spawn chance for newly discovered chunks (1 / N)
 #ifndef PASSIVE_SPAWN_CHANCE
   #define PASSIVE_SPAWN_CHANCE 6
@@ -77,6 +116,9 @@
 #define ENTITY_TYPE_VILLAGER 139
 #define ENTITY_TYPE_ZOMBIE 150
 
+// Protocol block entity type IDs from 1.21.11 minecraft:block_entity_type.
+#define BLOCK_ENTITY_TYPE_CHEST 1
+
 // Calculated from TIME_BETWEEN_TICKS
 #define TICKS_PER_SECOND ((float)1000000 / TIME_BETWEEN_TICKS)
 
@@ -111,9 +153,9 @@
 // Calculated from BIOME_SIZE
 #define BIOME_RADIUS (BIOME_SIZE / 2)
 
-// Per-player recently visited chunk history.
-// Chunks in this window are not re-sent on movement updates.
-// Must be at least 1.
+// Length of the former per-player visited chunk history.
+// Only sizes a reserved PlayerData field now, so that existing
+// world.bin files keep their layout. Must be at least 1.
 #ifndef VISITED_HISTORY
   #define VISITED_HISTORY 4
 #endif
@@ -123,6 +165,41 @@
   #define MAX_BLOCK_CHANGES 20000
 #endif
 
+// Fluid updates outside simulation distance held back until a player
+// comes close enough for them to flow.
+#ifndef MAX_DEFERRED_FLUID_UPDATES
+  #define MAX_DEFERRED_FLUID_UPDATES 256
+#endif
+
+// Sections whose computed block light is kept between chunk sends.
+// Each entry costs about 2 KiB.
+#ifndef BLOCK_LIGHT_CACHE_SIZE
+  #ifdef ESP_PLATFORM
+    #define BLOCK_LIGHT_CACHE_SIZE 16
+  #else
+    #define BLOCK_LIGHT_CACHE_SIZE 512
+  #endif
+#endif
+
+// Sections of blocks kept decoded for gameplay lookups (getBlockAt).
+// Each entry costs 4 KiB.
+#ifndef BLOCK_CACHE_SIZE
+  #define BLOCK_CACHE_SIZE 8
+#endif
+
+// Chunks whose column summaries (surface height, top solid block,
+// spawnable surface) are kept for spawn searches. Each entry costs
+// about 1 KiB.
+#ifndef CHUNK_SUMMARY_CACHE_SIZE
+  #define CHUNK_SUMMARY_CACHE_SIZE 8
+#endif
+
+// Tiles of minichunk biomes kept per worldgen context. Each tile covers
+// 16x16 minichunks (128x128 blocks by default) and costs about 270 bytes.
+#ifndef BIOME_TILE_CACHE_SIZE
+  #define BIOME_TILE_CACHE_SIZE 16
+#endif
+
 // Notchian-derived worldgen defaults generated from datapack JSON.
 // Regenerate via: make worldgen-sync-defaults
 #include "worldgen_notchian_defaults.h"
@@ -249,6 +326,12 @@
   #define WORLDGEN_VALLEY_EROSION_MIN 58
 #endif
 
+// Computes worldgen noise in fixed point instead of floating point, for
+// cores without an FPU. Noise is then bit-identical on every platform,
+// so a seed gives the same terrain on a host and on ESP targets as long
+// as both enable this. That terrain differs from the floating point one.
+// #define WORLDGEN_FIXED_NOISE
+
 // Enables synchronous world persistence to disk/flash.
 // Runtime state stays in memory; disk is read on startup and written on updates.
 // Disabled by default on ESP because flash writes are expensive.
@@ -256,6 +339,31 @@
   #define SYNC_WORLD_TO_DISK
 #endif
 
+// Serves unmodified chunks from a store written by `nethr pregen`.
+// Needs mmap and fork, so only available on POSIX hosts.
+#if !defined(ESP_PLATFORM) && !defined(_WIN32)
+  #define USE_CHUNK_STORE
+#endif
+
+// Generates and encodes chunks on a pool of worker threads, one per core.
+// Needs pthreads, so only available on POSIX hosts.
+#if !defined(ESP_PLATFORM) && !defined(_WIN32)
+  #define USE_CHUNK_JOBS
+#endif
+
+// Chunk jobs that can be queued or waiting to be sent at once.
+// Each finished job holds one encoded chunk body in memory.
+#ifndef CHUNK_JOB_SLOTS
+  #define CHUNK_JOB_SLOTS 48
+#endif
+
+// Sends solid blocks enclosed on all sides by other solid blocks as the
+// most common solid block of their section, so that underground sections
+// pack into small palettes. True blocks are revealed as they get exposed.
+// Only pays off for sections without caves, which are rare with the
+// current cave density, hence disabled by default.
+// #define OCCLUDE_HIDDEN_BLOCKS
+
 // Minimum interval for periodic disk flushes (microseconds).
 // Applies to player data by default; block changes can opt in below.
 #define DISK_SYNC_INTERVAL 15000000
@@ -320,6 +428,10 @@
 // Log chunk generation timings.
 // #define DEV_LOG_CHUNK_GENERATION
 
+// Time each stage of chunk generation and enable `nethr bench-worldgen`.
+// Set by `make bench-worldgen`, which builds a separate binary for it.
+// #define WORLDGEN_PROFILE
+
 // Enable unauthenticated raw world dump/import commands (0xBEEF / 0xFEED).
 // #define DEV_ENABLE_BEEF_DUMPS
 
@@ -346,6 +458,7 @@ extern uint8_t world_spawn_locked;
 extern uint16_t world_time;
 extern uint32_t server_ticks;
 extern int view_distance;
+extern int simulation_distance;
 
 extern char motd[];
 extern uint8_t motd_len;
@@ -373,8 +486,8 @@ typedef struct {
   short x;
   uint8_t y;
   short z;
-  short visited_x[VISITED_HISTORY];
-  short visited_z[VISITED_HISTORY];
+  // Formerly the visited chunk history, see VISITED_HISTORY
+  short reserved_visited[VISITED_HISTORY * 2];
   #ifdef SCALE_MOVEMENT_UPDATES_TO_PLAYER_COUNT
     uint16_t packets_since_update;
   #endif
@@ -0,0 +1,13 @@
+#ifndef H_LIGHT
+#define H_LIGHT
+
+#include <stdint.h>
+
+void initLightTables ();
+uint8_t getBlockLightEmission (uint8_t block);
+uint8_t propagateSectionSkyLight (const uint8_t *blocks, uint8_t *column_level, uint8_t *out);
+uint32_t getChunkBlockLight (int x, int z, const uint8_t *chunk_blocks, int section_count, int base_y, uint8_t *out);
+void invalidateBlockLightAt (short x, uint8_t y, short z);
+void clearBlockLightCache ();
+
+#endif
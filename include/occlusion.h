@@ -0,0 +1,17 @@
+#ifndef H_OCCLUSION
+#define H_OCCLUSION
+
+#include <stdint.h>
+
+#include "globals.h"
+
+#ifdef OCCLUDE_HIDDEN_BLOCKS
+  uint8_t isOccludingBlock (uint8_t block);
+  int occludeSection (const uint8_t *below, const uint8_t *blocks, const uint8_t *above, int x, int y, int z, uint8_t *out);
+#else
+  // Define no-op placeholders for when all blocks are sent as they are
+  #define isOccludingBlock(block) false
+  #define occludeSection(below, blocks, above, x, y, z, out) 0
+#endif
+
+#endif
@@ -41,6 +41,11 @@ int sc_startWaitingForChunks (int client_fd);
 int sc_playerAbilities (int client_fd, uint8_t flags);
 int sc_updateTime (int client_fd, uint64_t ticks);
 int sc_setCenterChunk (int client_fd, int x, int y);
+int sc_setChunkCacheRadius (int client_fd, int radius);
+int sc_forgetLevelChunk (int client_fd, int x, int z);
+int sc_chunkBatchStart (int client_fd);
+int sc_chunkBatchFinished (int client_fd, int batch_size);
+uint8_t isChunkPacketReady (int _x, int _z);
 int sc_chunkDataAndUpdateLight (int client_fd, int _x, int _z);
 int sc_keepAlive (int client_fd);
 int sc_setContainerSlot (int client_fd, int window_id, uint16_t slot, uint8_t count, uint16_t item);
@@ -73,4 +78,9 @@ int sc_removeEntity (int client_fd, int entity_id);
 int sc_pickupItem (int client_fd, int collected, int collector, uint8_t count);
 int sc_registries (int client_fd);
 
+// Upper bound of an encoded procedural chunk packet body
+#define CHUNK_PACKET_BODY_MAX 240000
+void initChunkPacketEncoder ();
+size_t buildChunkPacketBody (uint8_t *body, int _x, int _z);
+
 #endif
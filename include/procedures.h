@@ -42,6 +42,7 @@ void invalidateBlockChangeIndex ();
 int firstBlockChangeInChunk (short chunk_x, short chunk_z);
 int nextIndexedBlockChange (int index);
 int findBlockChangeIndex (short x, uint8_t y, short z);
+uint8_t hasBlockChangesNear (short x, short z);
 
 uint8_t isInstantlyMined (PlayerData *player, uint8_t block);
 uint8_t isColumnBlock (uint8_t block);
@@ -18,6 +18,7 @@ ssize_t send_all (int client_fd, const void *buf, ssize_t len);
 void discard_all (int client_fd, size_t remaining, uint8_t require_first);
 void flush_send_buffer (int client_fd);
 void flush_all_send_buffers ();
+size_t getPendingSendBytes (int client_fd);
 
 ssize_t writeByte (int client_fd, uint8_t byte);
 ssize_t writeUint16 (int client_fd, uint16_t num);
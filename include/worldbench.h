@@ -0,0 +1,21 @@
+#ifndef H_WORLDBENCH
+#define H_WORLDBENCH
+
+#include <stdint.h>
+
+#include "globals.h"
+
+#ifdef WORLDGEN_PROFILE
+  int runWorldgenBench (int chunk_count, uint8_t record);
+#else
+  #include <stdio.h>
+  // Builds without stage timing only point to the benchmark build
+  static inline int runWorldgenBench (int chunk_count, uint8_t record) {
+    (void)chunk_count;
+    (void)record;
+    printf("nethr was built without WORLDGEN_PROFILE, use `make bench-worldgen`\n");
+    return 1;
+  }
+#endif
+
+#endif
@@ -3,6 +3,19 @@
 
 #include <stdint.h>
 
+#include "globals.h"
+
+// Revision of the terrain generator output. Bump whenever generated
+// blocks change, so that pregenerated chunk stores are discarded.
+#define WORLDGEN_REVISION 2
+
+// Fixed-point noise generates another world from the same seed
+#ifdef WORLDGEN_FIXED_NOISE
+  #define WORLDGEN_VERSION (WORLDGEN_REVISION | 0x8000)
+#else
+  #define WORLDGEN_VERSION WORLDGEN_REVISION
+#endif
+
 typedef struct {
   short x;
   short z;
@@ -17,14 +30,202 @@ typedef struct {
   uint8_t variant;
 } ChunkFeature;
 
+// Maps a section-local address (dx + dz * 16 + dy * 256) to its index
+// in the client's reversed 8-block ordering, as built by buildChunkSection.
+static inline unsigned getSectionBlockIndex (unsigned address) {
+  return (address & ~7u) | (7u - (address & 7u));
+}
+
+// Types of Placement
+#define PLACEMENT_RUINED_PORTAL 0
+#define PLACEMENT_LAVA_POOL 1
+
+// Structure or surface feature spanning several columns, placed once
+// per chunk by findChunkPlacements
+typedef struct {
+  // Bounding box of the columns it may change, inclusive
+  int min_x;
+  int min_z;
+  int max_x;
+  int max_z;
+  // Center column, and the hash its shape is derived from
+  int x;
+  int z;
+  uint32_t hash;
+  // Base height of ruined portals, or radius of lava pools
+  uint8_t y;
+  uint8_t type;
+} Placement;
+
+// Up to one ruined portal and one lava pool from each of the chunk and
+// its 8 neighbours can reach into a chunk
+#define CHUNK_PLACEMENTS_MAX 10
+
+typedef struct {
+  Placement list[CHUNK_PLACEMENTS_MAX];
+  uint8_t count;
+} ChunkPlacements;
+
+// Column can be reached by a ruined portal
+#define COLUMN_NEAR_PORTAL 1
+// Column can hold a surface cave mouth
+#define COLUMN_CAVE_MOUTH 2
+
+// Decisions about one terrain column that hold for all of its blocks
+typedef struct {
+  float cave_roughness;
+  uint8_t height;
+  uint8_t flags;
+  uint8_t aquifer_level;
+  // Lava pool block in the top two blocks, or 0xFF
+  uint8_t lava_pool;
+  // Blocks at y = height and y = height + 1 on land (height >= 63)
+  uint8_t surface;
+  uint8_t cover;
+  // Highest y at which the column can hold anything but air
+  uint8_t air_top;
+} ChunkColumn;
+
+// Surface flags of a ColumnSummary
+// Blocks above the top solid block leave room for a mob to spawn on it
+#define COLUMN_SPAWNABLE 1
+// Solid ground with air above at terrain height, at or above sea level
+#define COLUMN_DRY_LAND 2
+// Water at or right above terrain height, and not dry land
+#define COLUMN_WET 4
+
+// Summary of one column of final blocks, see getColumnSummary
+typedef struct {
+  // Terrain height, as returned by getHeightAt
+  uint8_t height;
+  // Height difference between the four adjacent columns
+  uint8_t slope;
+  // Highest block that is not passable, block changes included
+  uint8_t top_solid;
+  uint8_t flags;
+} ColumnSummary;
+
+// Side of the square tiles of minichunk biomes kept per context, in
+// minichunks. At most 32, as rows are tracked in a 32-bit mask. Each
+// tile costs BIOME_TILE_SIDE^2 bytes plus a small header.
+#define BIOME_TILE_SIDE 16
+
+typedef struct {
+  // Tile coordinates, in units of BIOME_TILE_SIDE minichunks
+  short x;
+  short z;
+  uint8_t valid;
+  uint32_t last_use;
+  // Bit dz is set once row dz of biomes has been filled in
+  uint32_t rows_ready;
+  uint8_t biomes[BIOME_TILE_SIDE * BIOME_TILE_SIDE];
+} BiomeTile;
+
+// Side of the direct-mapped tile of anchor corner heights kept per
+// context, in anchors. Must be a power of two; 32 spans 256x256 blocks.
+#define CORNER_HEIGHT_CACHE_SIDE 32
+
+typedef struct {
+  short x;
+  short z;
+  uint8_t height;
+  uint8_t used;
+} CornerHeightCacheEntry;
+
+// Spacing of the cave noise lattice in blocks: 4 along x and z, 8 along
+// y. Lattice levels sit at y = 8 * level, up to the height cap.
+#define CAVE_LATTICE_LEVELS (WORLDGEN_HEIGHT_CAP / 8 + 2)
+// Levels below y = 64, the only ones that can hold caverns
+#define CAVERN_LATTICE_LEVELS 8
+
+// Cave noise at the 5x5 lattice columns spanning the chunk at block
+// (x, z), including its far edges, indexed by dx / 4 + dz / 4 * 5.
+// Levels are sampled when first needed.
+typedef struct {
+  int x;
+  int z;
+  uint8_t valid;
+  uint64_t levels_ready;
+  float field[CAVE_LATTICE_LEVELS][25];
+  float cavern[CAVERN_LATTICE_LEVELS][25];
+} CaveLattice;
+
+// Stages of chunk generation timed with WORLDGEN_PROFILE: minichunk
+// anchors and features, terrain heights along with everything else
+// worked out per column, blocks of each section, and block changes
+#define WORLDGEN_STAGE_ANCHORS 0
+#define WORLDGEN_STAGE_HEIGHTS 1
+#define WORLDGEN_STAGE_TERRAIN 2
+#define WORLDGEN_STAGE_CHANGES 3
+#define WORLDGEN_STAGE_COUNT 4
+
+/**
+ * Scratch state of chunk generation and encoding. Every thread that
+ * generates chunks binds its own context with setWorldgenContext, which
+ * makes generation reentrant. The main thread starts out with a default
+ * context of its own.
+ */
+typedef struct {
+  // Encoded blocks of the last section built by buildChunkSection
+  uint8_t section[4096];
+  ChunkAnchor anchors[(16 / CHUNK_SIZE + 1) * (16 / CHUNK_SIZE + 1)];
+  ChunkFeature features[256 / (CHUNK_SIZE * CHUNK_SIZE)];
+  // Columns of the chunk at block (columns_x, columns_z), see buildChunkSection
+  ChunkColumn columns[256];
+  int columns_x;
+  int columns_z;
+  uint8_t columns_ready;
+  // Highest air_top among the columns
+  int columns_air_top;
+  // Structures and surface features reaching into those columns
+  ChunkPlacements placements;
+  // Placements reaching into the column of a getTerrainAt lookup
+  ChunkPlacements column_placements;
+  // Scratch grids for batched noise sampling
+  float noise_grid[2][256];
+  // Least recently used tiles of biomes, see getChunkBiome
+  BiomeTile biome_tiles[BIOME_TILE_CACHE_SIZE];
+  uint32_t biome_tile_clock;
+  int biome_tile_last;
+  CornerHeightCacheEntry corner_height_cache[CORNER_HEIGHT_CACHE_SIDE * CORNER_HEIGHT_CACHE_SIDE];
+  // Cave noise lattice of the chunk caves were last carved in
+  CaveLattice cave_lattice;
+  // Block and sky light solver levels, see getChunkBlockLight and
+  // propagateSectionSkyLight
+  uint8_t light_levels[4096];
+  uint8_t sky_light_levels[4096];
+  // Blocks queued while spreading light, see spreadLight
+  uint16_t light_queue[2][4096];
+  // Blocks of the section being encoded, as sent to the client
+  uint8_t visible_section[4096];
+  // Sky light entering the top of each section of the chunk being encoded
+  uint8_t sky_entry_level[24][256];
+  // Ignore player block changes, which only the main thread may read.
+  // Output then matches chunks without nearby changes.
+  uint8_t terrain_only;
+  #ifdef WORLDGEN_PROFILE
+  // Nanoseconds spent in each WORLDGEN_STAGE_*, added up until reset
+  int64_t stage_time[WORLDGEN_STAGE_COUNT];
+  #endif
+} WorldgenContext;
+
+WorldgenContext *getWorldgenContext ();
+void setWorldgenContext (WorldgenContext *context);
+
 uint32_t getChunkHash (short x, short z);
 uint8_t getChunkBiome (short x, short z);
-uint8_t getHeightAtFromHash (int rx, int rz, int _x, int _z, uint32_t chunk_hash, uint8_t biome);
+uint8_t getHeightAtFromAnchor (int rx, int rz, int _x, int _z, uint8_t biome);
 uint8_t getHeightAt (int x, int z);
 uint8_t getTerrainAt (int x, int y, int z, ChunkAnchor anchor);
 uint8_t getBlockAt (int x, int y, int z);
 
-extern uint8_t chunk_section[4096];
 uint8_t buildChunkSection (int cx, int cy, int cz);
+uint8_t mayTerrainEmitLight (int x, int y, int z);
+void updateBlockCache (short x, uint8_t y, short z, uint8_t block);
+void clearBlockCache ();
+
+uint8_t getColumnSummary (int x, int z, uint8_t with_blocks, ColumnSummary *column);
+void updateChunkSummary (short x, uint8_t y, short z, uint8_t block);
+void clearChunkSummaries ();
 
 #endif
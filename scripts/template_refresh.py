@@ -25,6 +25,8 @@ DEFAULT_PORT = 25566
 DEFAULT_TARGET = 64
 DEFAULT_TIMEOUT = 30.0
 DEFAULT_OUTDIR = "assets/chunks"
+PACK_NAME = "chunk_templates.pack"
+PACK_VERSION = 1
 
 
 def encode_varint(value: int) -> bytes:
@@ -126,6 +128,24 @@ def ensure_dir(path: str):
     os.makedirs(path, exist_ok=True)
 
 
+def write_pack(path: str, chunks):
+    """
+    Writes all templates into one file the server can memory-map:
+    "NTPK", u32 version, u32 count, count * (i32 x, i32 z, u32 offset,
+    u32 length), then the packet bodies. Integers are big-endian.
+    """
+    offset = 12 + 16 * len(chunks)
+    index = bytearray()
+    for chunk_x, chunk_z, body in chunks:
+        index += struct.pack(">iiII", chunk_x, chunk_z, offset, len(body))
+        offset += len(body)
+    with open(path, "wb") as file:
+        file.write(b"NTPK" + struct.pack(">II", PACK_VERSION, len(chunks)))
+        file.write(index)
+        for _, _, body in chunks:
+            file.write(body)
+
+
 def main():
     parser = argparse.ArgumentParser(description="Capture Notchian chunk templates.")
     parser.add_argument("--host", default=DEFAULT_HOST)
@@ -255,9 +275,13 @@ def main():
         print("error: no templates captured; keeping existing templates unchanged.")
         return
 
+    pack_path = os.path.join(tmp_outdir, PACK_NAME)
+    write_pack(pack_path, chunks)
+    print(f"packed {len(chunks)} templates -> {pack_path}")
+
     # Atomic-ish swap: keep existing templates until we have a valid new set.
     for name in os.listdir(args.outdir):
-        if name.startswith("chunk_template_") and name.endswith(".bin"):
+        if (name.startswith("chunk_template_") and name.endswith(".bin")) or name == PACK_NAME:
             os.remove(os.path.join(args.outdir, name))
     for name in sorted(os.listdir(tmp_outdir)):
         shutil.move(os.path.join(tmp_outdir, name), os.path.join(args.outdir, name))
@@ -0,0 +1,327 @@
+#include "globals.h"
+
+#ifdef USE_CHUNK_JOBS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "tools.h"
+#include "worldgen.h"
+#include "packets.h"
+#include "chunkjobs.h"
+
+#define CHUNK_JOB_WORKERS_MAX 16
+// Finished bodies nobody took for this long (microseconds) may be evicted
+#define CHUNK_JOB_READY_TTL 5000000
+// Job slots that prefetched chunks may take up at once
+#define CHUNK_JOB_PREFETCH_SLOTS (CHUNK_JOB_SLOTS / 4)
+
+enum {
+  CHUNK_JOB_FREE,
+  CHUNK_JOB_QUEUED,
+  CHUNK_JOB_READY
+};
+
+typedef struct ChunkJob {
+  int x;
+  int z;
+  // Only touched by the main thread
+  uint8_t state;
+  // Prefetched ahead of a moving player, not in anyone's view yet
+  uint8_t speculative;
+  int64_t ready_time;
+  // Written by the worker before the job is published as done
+  uint8_t *body;
+  size_t length;
+  struct ChunkJob *next_done;
+} ChunkJob;
+
+/**
+ * Job deque of one worker. The owner takes its oldest job, so chunks
+ * come out roughly in the order they were requested (nearest first),
+ * while idle workers steal the newest job from the other end.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  ChunkJob *jobs[CHUNK_JOB_SLOTS];
+  int head;
+  int count;
+} ChunkJobDeque;
+
+static ChunkJob chunk_jobs[CHUNK_JOB_SLOTS];
+static ChunkJobDeque job_deques[CHUNK_JOB_WORKERS_MAX];
+static int worker_count = 0;
+static int next_deque = 0;
+static int speculative_jobs = 0;
+// 0 = not started yet, 1 = running, -1 = unavailable
+static int8_t chunk_jobs_state = 0;
+
+// Sleeping workers wait for queued_jobs to become non-zero. Each worker
+// that decrements it is guaranteed to find a job in one of the deques.
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static int queued_jobs = 0;
+
+// Finished jobs, pushed by workers and drained by the main thread
+static _Atomic(ChunkJob *) done_jobs = NULL;
+
+static ChunkJob *popOwnJob (ChunkJobDeque *deque) {
+  ChunkJob *job = NULL;
+  pthread_mutex_lock(&deque->lock);
+  if (deque->count > 0) {
+    job = deque->jobs[deque->head];
+    deque->head = (deque->head + 1) % CHUNK_JOB_SLOTS;
+    deque->count --;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return job;
+}
+
+static ChunkJob *stealJob (ChunkJobDeque *deque) {
+  ChunkJob *job = NULL;
+  pthread_mutex_lock(&deque->lock);
+  if (deque->count > 0) {
+    deque->count --;
+    job = deque->jobs[(deque->head + deque->count) % CHUNK_JOB_SLOTS];
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return job;
+}
+
+static void pushDoneJob (ChunkJob *job) {
+  ChunkJob *head = atomic_load_explicit(&done_jobs, memory_order_relaxed);
+  do {
+    job->next_done = head;
+  } while (!atomic_compare_exchange_weak_explicit(
+    &done_jobs, &head, job,
+    memory_order_release, memory_order_relaxed
+  ));
+}
+
+typedef struct {
+  int index;
+  WorldgenContext *context;
+  uint8_t *scratch;
+} ChunkWorker;
+
+static void *runChunkWorker (void *arg) {
+  ChunkWorker *worker = arg;
+  setWorldgenContext(worker->context);
+
+  while (true) {
+    pthread_mutex_lock(&idle_lock);
+    while (queued_jobs == 0) pthread_cond_wait(&idle_cond, &idle_lock);
+    queued_jobs --;
+    pthread_mutex_unlock(&idle_lock);
+
+    ChunkJob *job = popOwnJob(&job_deques[worker->index]);
+    for (int i = 1; job == NULL; i ++) {
+      job = stealJob(&job_deques[(worker->index + i) % worker_count]);
+    }
+
+    // Output depends only on the chunk coordinates, so it does not
+    // matter which worker generates which chunk
+    size_t length = buildChunkPacketBody(worker->scratch, job->x, job->z);
+    job->body = length == 0 ? NULL : malloc(length);
+    job->length = job->body == NULL ? 0 : length;
+    if (job->body != NULL) memcpy(job->body, worker->scratch, length);
+
+    pushDoneJob(job);
+  }
+
+  return NULL;
+}
+
+// Starts the worker pool on first use.
+// Returns true if chunk jobs can be queued.
+static uint8_t startChunkJobs () {
+  if (chunk_jobs_state != 0) return chunk_jobs_state == 1;
+  chunk_jobs_state = -1;
+
+  // Build the shared lookup tables before any worker reads them
+  initChunkPacketEncoder();
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int workers = cores < 1 ? 1 : (int)cores;
+  if (workers > CHUNK_JOB_WORKERS_MAX) workers = CHUNK_JOB_WORKERS_MAX;
+
+  for (int i = 0; i < workers; i ++) {
+    pthread_mutex_init(&job_deques[i].lock, NULL);
+    job_deques[i].head = 0;
+    job_deques[i].count = 0;
+  }
+
+  for (int i = 0; i < workers; i ++) {
+    ChunkWorker *worker = malloc(sizeof(ChunkWorker));
+    WorldgenContext *context = calloc(1, sizeof(WorldgenContext));
+    uint8_t *scratch = malloc(CHUNK_PACKET_BODY_MAX);
+    if (worker == NULL || context == NULL || scratch == NULL) {
+      free(worker);
+      free(context);
+      free(scratch);
+      break;
+    }
+    context->terrain_only = true;
+    worker->index = i;
+    worker->context = context;
+    worker->scratch = scratch;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, runChunkWorker, worker) != 0) {
+      free(worker);
+      free(context);
+      free(scratch);
+      break;
+    }
+    pthread_detach(thread);
+    worker_count = i + 1;
+  }
+
+  if (worker_count == 0) {
+    printf("Failed to start chunk workers, generating chunks inline\n\n");
+    return false;
+  }
+  printf("Started %d chunk generation workers\n\n", worker_count);
+  chunk_jobs_state = 1;
+  return true;
+}
+
+static ChunkJob *findChunkJob (int x, int z) {
+  for (int i = 0; i < CHUNK_JOB_SLOTS; i ++) {
+    ChunkJob *job = &chunk_jobs[i];
+    if (job->state != CHUNK_JOB_FREE && job->x == x && job->z == z) return job;
+  }
+  return NULL;
+}
+
+static void freeChunkJob (ChunkJob *job) {
+  free(job->body);
+  job->body = NULL;
+  job->length = 0;
+  if (job->speculative) speculative_jobs --;
+  job->speculative = false;
+  job->state = CHUNK_JOB_FREE;
+}
+
+// Returns true if the slot of `job` may be reused for another chunk and
+// its body is older than that of the candidate found so far, `best`.
+static uint8_t isBetterEvictee (ChunkJob *job, ChunkJob *best, uint8_t evict_speculative, int64_t now) {
+  if (job->state != CHUNK_JOB_READY) return false;
+  uint8_t stale = now - job->ready_time > CHUNK_JOB_READY_TTL;
+  if (!stale && !(evict_speculative && job->speculative)) return false;
+  return best == NULL || job->ready_time < best->ready_time;
+}
+
+// Takes a job slot for chunk (x, z) and hands it to a worker.
+// Returns 1 if no slot could be taken.
+static int queueChunkJob (int x, int z, uint8_t speculative) {
+
+  // Take a free slot, or else the oldest finished chunk nobody took
+  // in time. Chunks in view may also displace prefetched ones.
+  ChunkJob *job = NULL;
+  int64_t now = get_program_time();
+  for (int i = 0; i < CHUNK_JOB_SLOTS; i ++) {
+    ChunkJob *slot = &chunk_jobs[i];
+    if (slot->state == CHUNK_JOB_FREE) {
+      job = slot;
+      break;
+    }
+    if (isBetterEvictee(slot, job, !speculative, now)) job = slot;
+  }
+  if (job == NULL) return 1;
+  if (job->state != CHUNK_JOB_FREE) freeChunkJob(job);
+
+  job->x = x;
+  job->z = z;
+  job->state = CHUNK_JOB_QUEUED;
+  job->speculative = speculative;
+  if (speculative) speculative_jobs ++;
+  job->body = NULL;
+  job->length = 0;
+
+  // No deque can overflow, as there are only CHUNK_JOB_SLOTS jobs
+  ChunkJobDeque *deque = &job_deques[next_deque];
+  next_deque = (next_deque + 1) % worker_count;
+  pthread_mutex_lock(&deque->lock);
+  deque->jobs[(deque->head + deque->count) % CHUNK_JOB_SLOTS] = job;
+  deque->count ++;
+  pthread_mutex_unlock(&deque->lock);
+
+  pthread_mutex_lock(&idle_lock);
+  queued_jobs ++;
+  pthread_cond_signal(&idle_cond);
+  pthread_mutex_unlock(&idle_lock);
+
+  return 0;
+
+}
+
+// Queues chunk (x, z) for generation on the worker pool.
+// Returns 0 if the chunk is queued, finished or can be generated inline,
+// or 1 if all job slots are taken.
+int requestChunkJob (int x, int z) {
+  if (!startChunkJobs()) return 0;
+  ChunkJob *job = findChunkJob(x, z);
+  if (job != NULL) {
+    // A prefetched chunk that came into view
+    if (job->speculative) speculative_jobs --;
+    job->speculative = false;
+    return 0;
+  }
+  return queueChunkJob(x, z, false);
+}
+
+// Queues chunk (x, z) for generation ahead of need, using spare job
+// slots only. The body is held until the chunk is requested or expires.
+// Returns 0 if the chunk is queued or finished, 1 if no slot is spare.
+int prefetchChunkJob (int x, int z) {
+  if (!startChunkJobs()) return 1;
+  if (findChunkJob(x, z) != NULL) return 0;
+  if (speculative_jobs >= CHUNK_JOB_PREFETCH_SLOTS) return 1;
+  return queueChunkJob(x, z, true);
+}
+
+// Returns true if chunk (x, z) can be sent without waiting on a worker,
+// that is, if its job has finished or there is no worker pool.
+uint8_t isChunkJobReady (int x, int z) {
+  if (chunk_jobs_state == -1) return true;
+  ChunkJob *job = findChunkJob(x, z);
+  return job != NULL && job->state == CHUNK_JOB_READY;
+}
+
+// Hands the finished packet body of chunk (x, z) over to the caller,
+// who must free it, and writes its length. Returns NULL if there is none,
+// in which case the chunk has to be encoded inline.
+uint8_t *takeChunkJobBody (int x, int z, size_t *length) {
+  ChunkJob *job = findChunkJob(x, z);
+  if (job == NULL || job->state != CHUNK_JOB_READY) return NULL;
+
+  uint8_t *body = job->body;
+  *length = job->length;
+  job->body = NULL;
+  freeChunkJob(job);
+  return body;
+}
+
+// Moves jobs finished by the workers into the ready state.
+// Called from the main loop.
+void collectChunkJobs () {
+  if (chunk_jobs_state != 1) return;
+  ChunkJob *job = atomic_exchange_explicit(&done_jobs, NULL, memory_order_acquire);
+  int64_t now = get_program_time();
+  while (job != NULL) {
+    // A job without a body ran out of memory, which leaves
+    // that chunk to the inline encoder once it is taken
+    ChunkJob *next = job->next_done;
+    job->state = CHUNK_JOB_READY;
+    job->ready_time = now;
+    job = next;
+  }
+}
+
+#endif
@@ -0,0 +1,282 @@
+#include "globals.h"
+
+#ifdef USE_CHUNK_STORE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "tools.h"
+#include "worldgen.h"
+#include "procedures.h"
+#include "packets.h"
+#include "chunkstore.h"
+
+#define STORE_FILE_PATH "world.chunks"
+// Bump whenever stored bodies would be encoded differently, light included
+#define STORE_FORMAT_VERSION 2
+
+/**
+ * Pregenerated chunk store layout (host byte order, like world.bin):
+ *   ChunkStoreHeader,
+ *   (2 * radius + 1)^2 ChunkStoreEntry records, row-major from
+ *   (center_x - radius, center_z - radius) along x,
+ *   packet bodies at their offsets.
+ * Bodies are complete level_chunk_with_light packets of terrain without
+ * any block changes, ready to be sent as-is.
+ */
+typedef struct {
+  char magic[4];
+  uint32_t format_version;
+  uint32_t world_seed;
+  uint32_t worldgen_version;
+  int32_t center_x;
+  int32_t center_z;
+  int32_t radius;
+  uint32_t reserved;
+} ChunkStoreHeader;
+
+typedef struct {
+  uint64_t offset;
+  uint32_t length;
+  uint32_t reserved;
+} ChunkStoreEntry;
+
+static const uint8_t *chunk_store = NULL;
+static size_t chunk_store_size = 0;
+static uint8_t chunk_store_opened = false;
+
+static void openChunkStore () {
+  if (chunk_store_opened) return;
+  chunk_store_opened = true;
+
+  int fd = open(STORE_FILE_PATH, O_RDONLY);
+  if (fd == -1) return;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ChunkStoreHeader)) {
+    close(fd);
+    return;
+  }
+  void *mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) return;
+
+  const ChunkStoreHeader *header = mapped;
+  size_t side = (size_t)header->radius * 2 + 1;
+  if (
+    memcmp(header->magic, "NCHK", 4) != 0 ||
+    header->format_version != STORE_FORMAT_VERSION ||
+    header->radius < 0 ||
+    sizeof(ChunkStoreHeader) + side * side * sizeof(ChunkStoreEntry) > (size_t)st.st_size
+  ) {
+    printf("Ignoring invalid chunk store \"%s\"\n\n", STORE_FILE_PATH);
+    munmap(mapped, (size_t)st.st_size);
+    return;
+  }
+  if (header->world_seed != world_seed || header->worldgen_version != WORLDGEN_VERSION) {
+    printf(
+      "Ignoring stale chunk store \"%s\" (seed %08X, generator v%u), run `make pregen` to rebuild it\n\n",
+      STORE_FILE_PATH, header->world_seed, header->worldgen_version
+    );
+    munmap(mapped, (size_t)st.st_size);
+    return;
+  }
+
+  chunk_store = mapped;
+  chunk_store_size = (size_t)st.st_size;
+  printf(
+    "Mapped chunk store \"%s\": %zu chunks around (%d, %d), %zu bytes\n\n",
+    STORE_FILE_PATH, side * side, header->center_x, header->center_z, chunk_store_size
+  );
+}
+
+// Returns the stored packet body of chunk (x, z) and writes its length,
+// or returns NULL if the chunk is not stored or has been modified.
+const uint8_t *getStoredChunkBody (int x, int z, size_t *length) {
+  openChunkStore();
+  if (chunk_store == NULL) return NULL;
+
+  const ChunkStoreHeader *header = (const ChunkStoreHeader *)chunk_store;
+  int dx = x - header->center_x + header->radius;
+  int dz = z - header->center_z + header->radius;
+  int side = header->radius * 2 + 1;
+  if (dx < 0 || dz < 0 || dx >= side || dz >= side) return NULL;
+
+  const ChunkStoreEntry *entry = (const ChunkStoreEntry *)(header + 1) + (dz * side + dx);
+  if (entry->length == 0) return NULL;
+  if (entry->offset > chunk_store_size || entry->length > chunk_store_size - entry->offset) return NULL;
+  if (hasBlockChangesNear(x, z)) return NULL;
+
+  *length = entry->length;
+  return chunk_store + entry->offset;
+}
+
+// Per-chunk record in a worker's part file, followed by the body.
+typedef struct {
+  int32_t x;
+  int32_t z;
+  uint32_t length;
+} ChunkStoreRecord;
+
+// Generates every `stride`-th chunk of the square, starting at `first`,
+// into a part file. Runs in a forked worker. Returns 0 on success.
+static int pregenChunkStorePart (const char *path, int center_x, int center_z, int radius, int first, int stride) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror("Failed to open chunk store part for writing");
+    return 1;
+  }
+  uint8_t *body = malloc(CHUNK_PACKET_BODY_MAX);
+  if (body == NULL) {
+    fclose(file);
+    return 1;
+  }
+
+  int side = radius * 2 + 1;
+  int total = side * side;
+  for (int i = first; i < total; i += stride) {
+    ChunkStoreRecord record;
+    record.x = center_x - radius + i % side;
+    record.z = center_z - radius + i / side;
+    size_t length = buildChunkPacketBody(body, record.x, record.z);
+    record.length = (uint32_t)length;
+    if (
+      length == 0 ||
+      fwrite(&record, sizeof(record), 1, file) != 1 ||
+      fwrite(body, 1, length, file) != length
+    ) {
+      perror("Failed to write chunk store part");
+      free(body);
+      fclose(file);
+      return 1;
+    }
+    if (first == 0 && (i / stride) % 256 == 0) {
+      printf("Pregen: %d/%d chunks\n", i, total);
+    }
+  }
+
+  free(body);
+  return fclose(file) == 0 ? 0 : 1;
+}
+
+/**
+ * Generates all chunks within `radius` of the world spawn chunk, using one
+ * forked worker per online core, and writes them to STORE_FILE_PATH.
+ * Workers are separate processes that each write a part file, merged
+ * here at the end.
+ * Block changes must not be loaded, as the store holds bare terrain.
+ * Returns 0 on success.
+ */
+int runChunkPregen (int radius) {
+
+  int center_x = div_floor(world_spawn_x, 16);
+  int center_z = div_floor(world_spawn_z, 16);
+  int side = radius * 2 + 1;
+  int total = side * side;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int workers = cores < 1 ? 1 : (int)cores;
+  if (workers > total) workers = total;
+
+  printf(
+    "Pregen: %d chunks around (%d, %d) with radius %d on %d workers\n",
+    total, center_x, center_z, radius, workers
+  );
+  int64_t start_time = get_program_time();
+
+  // Fork workers, each owning every `workers`-th chunk
+  char part_path[64];
+  for (int i = 0; i < workers; i ++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("Failed to fork pregen worker");
+      return 1;
+    }
+    if (pid == 0) {
+      snprintf(part_path, sizeof(part_path), "%s.part%d", STORE_FILE_PATH, i);
+      _exit(pregenChunkStorePart(part_path, center_x, center_z, radius, i, workers));
+    }
+  }
+  int failed = 0;
+  for (int i = 0; i < workers; i ++) {
+    int status = 0;
+    if (wait(&status) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+  }
+
+  ChunkStoreEntry *entries = calloc((size_t)total, sizeof(ChunkStoreEntry));
+  FILE *file = failed || entries == NULL ? NULL : fopen(STORE_FILE_PATH ".tmp", "wb");
+  if (file == NULL) failed = 1;
+
+  // Lay out header and a placeholder index, then append each part's bodies
+  ChunkStoreHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "NCHK", 4);
+  header.format_version = STORE_FORMAT_VERSION;
+  header.world_seed = world_seed;
+  header.worldgen_version = WORLDGEN_VERSION;
+  header.center_x = center_x;
+  header.center_z = center_z;
+  header.radius = radius;
+  if (!failed && (
+    fwrite(&header, sizeof(header), 1, file) != 1 ||
+    fwrite(entries, sizeof(ChunkStoreEntry), (size_t)total, file) != (size_t)total
+  )) failed = 1;
+
+  uint8_t *body = failed ? NULL : malloc(CHUNK_PACKET_BODY_MAX);
+  if (body == NULL) failed = 1;
+  for (int i = 0; i < workers; i ++) {
+    snprintf(part_path, sizeof(part_path), "%s.part%d", STORE_FILE_PATH, i);
+    FILE *part = failed ? NULL : fopen(part_path, "rb");
+    ChunkStoreRecord record;
+    while (part && fread(&record, sizeof(record), 1, part) == 1) {
+      int index = (record.z - center_z + radius) * side + (record.x - center_x + radius);
+      if (
+        record.length > CHUNK_PACKET_BODY_MAX ||
+        index < 0 || index >= total ||
+        fread(body, 1, record.length, part) != record.length
+      ) {
+        failed = 1;
+        break;
+      }
+      entries[index].offset = (uint64_t)ftello(file);
+      entries[index].length = record.length;
+      if (fwrite(body, 1, record.length, file) != record.length) {
+        failed = 1;
+        break;
+      }
+    }
+    if (part) fclose(part);
+    remove(part_path);
+  }
+  free(body);
+
+  // Fill in the index and publish the store
+  if (!failed && (
+    fseeko(file, (off_t)sizeof(header), SEEK_SET) != 0 ||
+    fwrite(entries, sizeof(ChunkStoreEntry), (size_t)total, file) != (size_t)total
+  )) failed = 1;
+  if (file && fclose(file) != 0) failed = 1;
+  free(entries);
+  if (!failed && rename(STORE_FILE_PATH ".tmp", STORE_FILE_PATH) != 0) failed = 1;
+
+  if (failed) {
+    remove(STORE_FILE_PATH ".tmp");
+    printf("Pregen failed, \"%s\" was left unchanged\n", STORE_FILE_PATH);
+    return 1;
+  }
+
+  int64_t elapsed = get_program_time() - start_time;
+  printf(
+    "Pregen: wrote %d chunks to \"%s\" in %.1fs (%.1f chunks/s)\n",
+    total, STORE_FILE_PATH, elapsed / 1000000.0, total * 1000000.0 / (elapsed > 0 ? elapsed : 1)
+  );
+  return 0;
+
+}
+
+#endif
@@ -0,0 +1,602 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "globals.h"
+#include "tools.h"
+#include "packets.h"
+#include "procedures.h"
+#include "chunkjobs.h"
+#include "chunkview.h"
+
+// Side of the square chunk window tracked around each player's view center
+#define VIEW_SIDE (MAX_VIEW_DISTANCE * 2 + 1)
+#define VIEW_BITMAP_BYTES ((VIEW_SIDE * VIEW_SIDE + 7) / 8)
+
+// Client batch rates in chunks per client tick, as in the notchian server
+#define CHUNK_RATE_START 9.0f
+#define CHUNK_RATE_MIN 0.01f
+#define CHUNK_RATE_MAX 64.0f
+// Batches allowed in flight once the client has acknowledged its first
+#define CHUNK_MAX_UNACKED_BATCHES 10
+
+/**
+ * Per-player chunk streaming state. Kept apart from PlayerData, which is
+ * persisted, as none of this outlives the connection.
+ * Both bitmaps hold one bit per chunk of the window centered on
+ * (center_x, center_z). `loaded` marks chunks the client holds, `pending`
+ * marks chunks in view distance that still have to be sent. A chunk is
+ * never in both, and neither holds chunks outside view distance.
+ */
+typedef struct {
+  short center_x;
+  short center_z;
+  uint16_t pending_count;
+  uint8_t pending[VIEW_BITMAP_BYTES];
+  uint8_t loaded[VIEW_BITMAP_BYTES];
+  // Chunks per client tick last requested by the client
+  float desired_rate;
+  // Chunks the next batch may hold, refilled by desired_rate each step
+  float quota;
+  uint8_t unacked_batches;
+  uint8_t max_unacked_batches;
+  // View distance used for this player, 0 until known
+  uint8_t distance;
+  // Mobs whose entity has been sent to this player, one bit per mob
+  uint8_t mob_tracked[(MAX_MOBS + 7) / 8];
+  // Smoothed horizontal velocity in blocks per second, estimated from
+  // the position last sampled at motion_time
+  float velocity_x;
+  float velocity_z;
+  short motion_x;
+  short motion_z;
+  int64_t motion_time;
+  uint8_t active;
+} ChunkView;
+
+static ChunkView chunk_views[MAX_PLAYERS];
+static uint8_t pending_scratch[VIEW_BITMAP_BYTES];
+static uint8_t loaded_scratch[VIEW_BITMAP_BYTES];
+static int64_t last_chunk_send_time = 0;
+static int next_chunk_view = 0;
+
+// Minimum time between two governor steps down, in microseconds
+#define VIEW_GOVERNOR_STEP_TIME 2000000
+// Share of main loop time spent sending chunks that counts as overload,
+// and the share below which there is headroom, in percent
+#define VIEW_GOVERNOR_BUSY_HIGH 75
+#define VIEW_GOVERNOR_BUSY_LOW 30
+
+// Distance up to which chunks are sent, lowered by the governor under load
+static int governed_distance = MAX_VIEW_DISTANCE;
+static int64_t governor_change_time = 0;
+static int64_t governor_headroom_time = 0;
+static int64_t governor_sample_time = 0;
+// Main loop time spent in drainChunkQueues since the last governor sample
+static int64_t chunk_send_busy_time = 0;
+
+static ChunkView *getChunkView (PlayerData *player) {
+  int index = (int)(player - player_data);
+  if (index < 0 || index >= MAX_PLAYERS) return NULL;
+  return &chunk_views[index];
+}
+
+// Bit index of the chunk at offset (dx, dz) from the view center
+static inline int viewBit (int dx, int dz) {
+  return (dz + MAX_VIEW_DISTANCE) * VIEW_SIDE + (dx + MAX_VIEW_DISTANCE);
+}
+
+static inline uint8_t testViewBit (const uint8_t *bitmap, int bit) {
+  return (bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static inline void setViewBit (uint8_t *bitmap, int bit) {
+  bitmap[bit >> 3] |= 1 << (bit & 7);
+}
+
+static inline void clearViewBit (uint8_t *bitmap, int bit) {
+  bitmap[bit >> 3] &= ~(1 << (bit & 7));
+}
+
+// Forgets all chunk streaming state of a player, call on disconnect.
+void clearChunkView (PlayerData *player) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL) return;
+  memset(view, 0, sizeof(ChunkView));
+}
+
+/**
+ * Moves the view center to (center_x, center_z). Chunks that left view
+ * distance are unloaded on the client if they had been sent, or dropped
+ * from the queue if not. Chunks that entered it are queued.
+ * Returns the amount of newly queued chunks.
+ */
+int recenterChunkView (PlayerData *player, short center_x, short center_z) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || !view->active) return 0;
+  if (view->center_x == center_x && view->center_z == center_z) return 0;
+
+  memcpy(pending_scratch, view->pending, VIEW_BITMAP_BYTES);
+  memcpy(loaded_scratch, view->loaded, VIEW_BITMAP_BYTES);
+  memset(view->pending, 0, VIEW_BITMAP_BYTES);
+  memset(view->loaded, 0, VIEW_BITMAP_BYTES);
+  view->pending_count = 0;
+
+  // Unload sent chunks that are out of range of the new center
+  for (int dz = -view->distance; dz <= view->distance; dz ++) {
+    for (int dx = -view->distance; dx <= view->distance; dx ++) {
+      if (!testViewBit(loaded_scratch, viewBit(dx, dz))) continue;
+      int x = view->center_x + dx, z = view->center_z + dz;
+      if (abs(x - center_x) <= view->distance && abs(z - center_z) <= view->distance) continue;
+      sc_forgetLevelChunk(player->client_fd, x, z);
+    }
+  }
+
+  // Carry over the state of chunks in range, queue the ones that entered it
+  int queued = 0;
+  for (int dz = -view->distance; dz <= view->distance; dz ++) {
+    for (int dx = -view->distance; dx <= view->distance; dx ++) {
+      int bit = viewBit(dx, dz);
+      int old_dx = center_x + dx - view->center_x;
+      int old_dz = center_z + dz - view->center_z;
+      if (abs(old_dx) <= view->distance && abs(old_dz) <= view->distance) {
+        int old_bit = viewBit(old_dx, old_dz);
+        if (testViewBit(loaded_scratch, old_bit)) {
+          setViewBit(view->loaded, bit);
+          continue;
+        }
+        if (!testViewBit(pending_scratch, old_bit)) continue;
+      } else queued ++;
+      setViewBit(view->pending, bit);
+      view->pending_count ++;
+    }
+  }
+
+  view->center_x = center_x;
+  view->center_z = center_z;
+  return queued;
+}
+
+/**
+ * Fully re-centers the view on (center_x, center_z), as after a spawn,
+ * respawn or teleport: every chunk the client holds is unloaded, tracked
+ * mobs are removed, and the whole view distance is queued again.
+ * Flow control state is kept if the player already had a view.
+ */
+void startChunkView (PlayerData *player, short center_x, short center_z) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL) return;
+
+  if (view->active) {
+    for (int dz = -view->distance; dz <= view->distance; dz ++) {
+      for (int dx = -view->distance; dx <= view->distance; dx ++) {
+        if (!testViewBit(view->loaded, viewBit(dx, dz))) continue;
+        sc_forgetLevelChunk(player->client_fd, view->center_x + dx, view->center_z + dz);
+      }
+    }
+    for (int i = 0; i < MAX_MOBS; i ++) {
+      if (!isMobTracked(player, i)) continue;
+      sc_removeEntity(player->client_fd, -2 - i);
+    }
+    memset(view->mob_tracked, 0, sizeof(view->mob_tracked));
+  } else {
+    if (view->distance == 0) view->distance = view_distance;
+    view->desired_rate = CHUNK_RATE_START;
+    view->quota = 0;
+    view->unacked_batches = 0;
+    view->max_unacked_batches = 1;
+    view->active = true;
+  }
+  view->center_x = center_x;
+  view->center_z = center_z;
+  view->velocity_x = 0;
+  view->velocity_z = 0;
+  view->motion_time = 0;
+  memset(view->loaded, 0, VIEW_BITMAP_BYTES);
+  memset(view->pending, 0, VIEW_BITMAP_BYTES);
+  view->pending_count = 0;
+
+  for (int dz = -view->distance; dz <= view->distance; dz ++) {
+    for (int dx = -view->distance; dx <= view->distance; dx ++) {
+      setViewBit(view->pending, viewBit(dx, dz));
+      view->pending_count ++;
+    }
+  }
+}
+
+/**
+ * Sets a player's view distance from the distance requested by their
+ * client, capped by the server's view_distance. An active view is resized
+ * in place: chunks now out of range are unloaded or dropped from the
+ * queue, chunks now in range are queued.
+ */
+void setChunkViewDistance (PlayerData *player, int requested) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL) return;
+
+  int distance = requested;
+  if (distance > view_distance) distance = view_distance;
+  if (distance < 2) distance = 2;
+  if (!view->active) {
+    view->distance = distance;
+    return;
+  }
+  if (distance == view->distance) return;
+
+  int outer = distance > view->distance ? distance : view->distance;
+  for (int dz = -outer; dz <= outer; dz ++) {
+    for (int dx = -outer; dx <= outer; dx ++) {
+      int bit = viewBit(dx, dz);
+      uint8_t in_old = abs(dx) <= view->distance && abs(dz) <= view->distance;
+      uint8_t in_new = abs(dx) <= distance && abs(dz) <= distance;
+      if (in_old && !in_new) {
+        if (testViewBit(view->loaded, bit)) {
+          sc_forgetLevelChunk(player->client_fd, view->center_x + dx, view->center_z + dz);
+          clearViewBit(view->loaded, bit);
+        } else if (testViewBit(view->pending, bit)) {
+          clearViewBit(view->pending, bit);
+          view->pending_count --;
+        }
+      } else if (!in_old && in_new) {
+        setViewBit(view->pending, bit);
+        view->pending_count ++;
+      }
+    }
+  }
+  view->distance = distance;
+  sc_setChunkCacheRadius(player->client_fd, distance);
+}
+
+// Returns the view distance of a player, or the server's before they spawn.
+int getChunkViewDistance (PlayerData *player) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || view->distance == 0) return view_distance;
+  return view->distance;
+}
+
+// Returns the simulation distance of a player, never above their view distance.
+int getSimulationDistance (PlayerData *player) {
+  int distance = getChunkViewDistance(player);
+  return simulation_distance < distance ? simulation_distance : distance;
+}
+
+// Checks whether the client of `player` holds chunk (x, z).
+uint8_t isChunkInView (PlayerData *player, int x, int z) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || !view->active) return false;
+  int dx = x - view->center_x, dz = z - view->center_z;
+  if (abs(dx) > view->distance || abs(dz) > view->distance) return false;
+  return testViewBit(view->loaded, viewBit(dx, dz));
+}
+
+// Checks whether chunk (x, z) is within simulation distance of any player.
+uint8_t isChunkSimulated (int x, int z) {
+  for (int i = 0; i < MAX_PLAYERS; i ++) {
+    ChunkView *view = &chunk_views[i];
+    if (player_data[i].client_fd == -1 || !view->active) continue;
+    int distance = getSimulationDistance(&player_data[i]);
+    if (abs(x - view->center_x) > distance || abs(z - view->center_z) > distance) continue;
+    return true;
+  }
+  return false;
+}
+
+// Checks whether the entity of mob `mob_index` has been sent to `player`.
+uint8_t isMobTracked (PlayerData *player, int mob_index) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL) return false;
+  return (view->mob_tracked[mob_index >> 3] >> (mob_index & 7)) & 1;
+}
+
+void setMobTracked (PlayerData *player, int mob_index, uint8_t tracked) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL) return;
+  if (tracked) view->mob_tracked[mob_index >> 3] |= 1 << (mob_index & 7);
+  else view->mob_tracked[mob_index >> 3] &= ~(1 << (mob_index & 7));
+}
+
+// Chunks further than this from the view center stay pending for now
+static int getSendDistance (ChunkView *view) {
+  return view->distance < governed_distance ? view->distance : governed_distance;
+}
+
+// Returns the bit of the queued chunk closest to the player, or -1.
+static int nearestPendingChunk (ChunkView *view, PlayerData *player) {
+  int player_dx = div_floor(player->x, 16) - view->center_x;
+  int player_dz = div_floor(player->z, 16) - view->center_z;
+
+  int send_distance = getSendDistance(view);
+  int best_bit = -1, best_distance = 0;
+  for (int dz = -send_distance; dz <= send_distance; dz ++) {
+    for (int dx = -send_distance; dx <= send_distance; dx ++) {
+      int bit = viewBit(dx, dz);
+      if (!testViewBit(view->pending, bit)) continue;
+      int distance = (dx - player_dx) * (dx - player_dx) + (dz - player_dz) * (dz - player_dz);
+      if (best_bit != -1 && distance >= best_distance) continue;
+      // Skip chunks that are still being generated by a worker
+      if (!isChunkPacketReady(view->center_x + dx, view->center_z + dz)) continue;
+      best_bit = bit;
+      best_distance = distance;
+    }
+  }
+  return best_bit;
+}
+
+// Samples a player's position after a movement packet, to estimate
+// their velocity for chunk prefetching.
+void trackChunkViewMotion (PlayerData *player) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || !view->active) return;
+
+  int64_t now = get_program_time();
+  int64_t elapsed = now - view->motion_time;
+  // Movement packets arrive every client tick at most, sample at half that
+  if (view->motion_time != 0 && elapsed < CHUNK_SEND_INTERVAL * 2) return;
+
+  int dx = player->x - view->motion_x;
+  int dz = player->z - view->motion_z;
+  view->motion_x = player->x;
+  view->motion_z = player->z;
+  uint8_t first = view->motion_time == 0;
+  view->motion_time = now;
+  // Skip the first sample, teleports and long pauses
+  if (first || elapsed > 1000000 || abs(dx) > 64 || abs(dz) > 64) {
+    view->velocity_x = 0;
+    view->velocity_z = 0;
+    return;
+  }
+
+  float seconds = elapsed / 1000000.0f;
+  view->velocity_x = view->velocity_x * 0.5f + dx / seconds * 0.5f;
+  view->velocity_z = view->velocity_z * 0.5f + dz / seconds * 0.5f;
+}
+
+#ifdef USE_CHUNK_JOBS
+// Queues generation jobs for the player's pending chunks, in rings
+// around the player's chunk, until the job slots run out.
+// Returns 1 if the job slots are all taken, 0 otherwise.
+static int requestPendingChunkJobs (ChunkView *view, PlayerData *player) {
+  int player_dx = div_floor(player->x, 16) - view->center_x;
+  int player_dz = div_floor(player->z, 16) - view->center_z;
+
+  int send_distance = getSendDistance(view);
+  for (int r = 0; r <= send_distance * 2; r ++) {
+    for (int dz = player_dz - r; dz <= player_dz + r; dz ++) {
+      if (dz < -send_distance || dz > send_distance) continue;
+      // Only the edge of the ring, its inside was covered already
+      int step = (dz == player_dz - r || dz == player_dz + r) ? 1 : r * 2;
+      for (int dx = player_dx - r; dx <= player_dx + r; dx += step) {
+        if (dx < -send_distance || dx > send_distance) continue;
+        if (!testViewBit(view->pending, viewBit(dx, dz))) continue;
+        int x = view->center_x + dx, z = view->center_z + dz;
+        if (isChunkPacketReady(x, z)) continue;
+        if (requestChunkJob(x, z)) return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * Prefetches the chunks a moving player is about to need: those in view
+ * distance of where they are predicted to be CHUNK_PREFETCH_LOOKAHEAD
+ * from now, but outside of their current view. Nearest chunks go first.
+ * They are only generated, and sent once they come into view.
+ * Returns 1 if no more chunks can be prefetched, 0 otherwise.
+ */
+static int prefetchChunksAhead (ChunkView *view, PlayerData *player) {
+  // Players that stopped sending positions are not moving
+  if (get_program_time() - view->motion_time > 1000000) return 0;
+  float lookahead = CHUNK_PREFETCH_LOOKAHEAD / 1000000.0f;
+  int ahead_x = div_floor(player->x + (int)(view->velocity_x * lookahead), 16);
+  int ahead_z = div_floor(player->z + (int)(view->velocity_z * lookahead), 16);
+  int player_x = div_floor(player->x, 16);
+  int player_z = div_floor(player->z, 16);
+  if (ahead_x == player_x && ahead_z == player_z) return 0;
+
+  int send_distance = getSendDistance(view);
+  int reach = send_distance + abs(ahead_x - player_x) + abs(ahead_z - player_z);
+  for (int r = send_distance + 1; r <= reach; r ++) {
+    for (int dz = -r; dz <= r; dz ++) {
+      int step = (dz == -r || dz == r) ? 1 : r * 2;
+      for (int dx = -r; dx <= r; dx += step) {
+        int x = player_x + dx, z = player_z + dz;
+        if (abs(x - ahead_x) > send_distance || abs(z - ahead_z) > send_distance) continue;
+        if (abs(x - view->center_x) <= view->distance && abs(z - view->center_z) <= view->distance) continue;
+        // Stored, modified or already generated chunks need no worker.
+        // A job for them would only hold a prefetch slot until it expires.
+        if (isChunkPacketReady(x, z)) continue;
+        if (prefetchChunkJob(x, z)) return 1;
+      }
+    }
+  }
+  return 0;
+}
+#endif
+
+/**
+ * Sends the player's next batch of queued chunks, nearest first, if the
+ * client's flow control allows one. The batch holds at most `budget`
+ * chunks and whatever the client's reported rate has accumulated.
+ * Returns the amount of chunks sent.
+ */
+int sendQueuedChunks (PlayerData *player, int budget) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || !view->active || player->client_fd == -1) return 0;
+  if (view->pending_count == 0 || budget <= 0) return 0;
+  if (view->unacked_batches >= view->max_unacked_batches) return 0;
+
+  float quota_cap = view->desired_rate > 1.0f ? view->desired_rate : 1.0f;
+  view->quota += view->desired_rate;
+  if (view->quota > quota_cap) view->quota = quota_cap;
+  if (view->quota < 1.0f) return 0;
+
+  int limit = (int)view->quota;
+  if (limit > budget) limit = budget;
+
+  #ifdef DEV_LOG_CHUNK_GENERATION
+    clock_t start = clock();
+  #endif
+
+  int sent = 0;
+  while (sent < limit) {
+    int bit = nearestPendingChunk(view, player);
+    if (bit == -1) break;
+    if (sent == 0) sc_chunkBatchStart(player->client_fd);
+    clearViewBit(view->pending, bit);
+    setViewBit(view->loaded, bit);
+    view->pending_count --;
+    int x = view->center_x + bit % VIEW_SIDE - MAX_VIEW_DISTANCE;
+    int z = view->center_z + bit / VIEW_SIDE - MAX_VIEW_DISTANCE;
+    sc_chunkDataAndUpdateLight(player->client_fd, x, z);
+    sent ++;
+  }
+  if (sent == 0) return 0;
+
+  sc_chunkBatchFinished(player->client_fd, sent);
+  view->unacked_batches ++;
+  view->quota -= sent;
+
+  #ifdef DEV_LOG_CHUNK_GENERATION
+    double total_ms = (double)(clock() - start) / CLOCKS_PER_SEC * 1000;
+    printf(
+      "Sent %d chunks to %s in %.0f ms (%.2f ms per chunk), %d queued\n",
+      sent, player->name, total_ms, total_ms / (double)sent, view->pending_count
+    );
+  #endif
+
+  return sent;
+}
+
+/**
+ * Sends the queued chunk (x, z) to the player right away as a batch of
+ * its own, encoding it on the main thread if no worker has finished it.
+ * Used for the spawn chunk, which must arrive before the player is placed.
+ */
+void sendChunkNow (PlayerData *player, int x, int z) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || !view->active || player->client_fd == -1) return;
+  int dx = x - view->center_x, dz = z - view->center_z;
+  if (abs(dx) > view->distance || abs(dz) > view->distance) return;
+  int bit = viewBit(dx, dz);
+  if (!testViewBit(view->pending, bit)) return;
+
+  clearViewBit(view->pending, bit);
+  setViewBit(view->loaded, bit);
+  view->pending_count --;
+  sc_chunkBatchStart(player->client_fd);
+  sc_chunkDataAndUpdateLight(player->client_fd, x, z);
+  sc_chunkBatchFinished(player->client_fd, 1);
+  view->unacked_batches ++;
+}
+
+// Applies a client's Chunk Batch Received acknowledgement.
+void handleChunkBatchReceived (PlayerData *player, float desired_rate) {
+  ChunkView *view = getChunkView(player);
+  if (view == NULL || !view->active) return;
+
+  if (view->unacked_batches > 0) view->unacked_batches --;
+  if (isnan(desired_rate) || desired_rate < CHUNK_RATE_MIN) desired_rate = CHUNK_RATE_MIN;
+  if (desired_rate > CHUNK_RATE_MAX) desired_rate = CHUNK_RATE_MAX;
+  view->desired_rate = desired_rate;
+  if (view->unacked_batches == 0) view->quota = 1.0f;
+  view->max_unacked_batches = CHUNK_MAX_UNACKED_BATCHES;
+}
+
+/**
+ * Drains chunk queues once per CHUNK_SEND_INTERVAL, sending at most
+ * CHUNK_SEND_BUDGET chunks in total. The first player served rotates
+ * between steps so that nobody is starved by a large join.
+ */
+void drainChunkQueues () {
+  int64_t step_start = get_program_time();
+  if (step_start - last_chunk_send_time < CHUNK_SEND_INTERVAL) return;
+
+  // Hand chunks to the worker pool ahead of sending, so that they are
+  // generated in parallel while earlier ones go out. Slots left over
+  // after that go to chunks that moving players are about to need.
+  #ifdef USE_CHUNK_JOBS
+    collectChunkJobs();
+    uint8_t slots_left = true;
+    for (int n = 0; n < MAX_PLAYERS && slots_left; n ++) {
+      PlayerData *player = &player_data[(next_chunk_view + n) % MAX_PLAYERS];
+      if (player->client_fd == -1) continue;
+      ChunkView *view = getChunkView(player);
+      if (!view->active || view->pending_count == 0) continue;
+      if (requestPendingChunkJobs(view, player)) slots_left = false;
+    }
+    for (int n = 0; n < MAX_PLAYERS && slots_left; n ++) {
+      PlayerData *player = &player_data[(next_chunk_view + n) % MAX_PLAYERS];
+      if (player->client_fd == -1) continue;
+      ChunkView *view = getChunkView(player);
+      if (!view->active) continue;
+      if (prefetchChunksAhead(view, player)) slots_left = false;
+    }
+  #endif
+
+  int budget = CHUNK_SEND_BUDGET;
+  for (int n = 0; n < MAX_PLAYERS && budget > 0; n ++) {
+    int i = (next_chunk_view + n) % MAX_PLAYERS;
+    if (player_data[i].client_fd == -1) continue;
+    budget -= sendQueuedChunks(&player_data[i], budget);
+  }
+  next_chunk_view = (next_chunk_view + 1) % MAX_PLAYERS;
+
+  // Measured after sending, so slow generation leaves room for packets
+  last_chunk_send_time = get_program_time();
+  chunk_send_busy_time += last_chunk_send_time - step_start;
+}
+
+/**
+ * Adjusts the distance up to which chunks are sent, call once per server
+ * tick with the time the tick took. Slow ticks, chunk sending hogging the
+ * main loop or a large send backlog lower it by one step at a time. It is
+ * raised again one step per VIEW_GOVERNOR_RESTORE_TIME of clear headroom,
+ * which keeps it from oscillating. Chunks already sent are kept.
+ */
+void updateViewGovernor (int64_t tick_duration) {
+  int64_t now = get_program_time();
+  int64_t elapsed = now - governor_sample_time;
+  if (elapsed <= 0) return;
+  int busy_percent = (int)(chunk_send_busy_time * 100 / elapsed);
+  chunk_send_busy_time = 0;
+  governor_sample_time = now;
+
+  size_t backlog = 0;
+  for (int i = 0; i < MAX_PLAYERS; i ++) {
+    if (player_data[i].client_fd == -1 || !chunk_views[i].active) continue;
+    size_t pending = getPendingSendBytes(player_data[i].client_fd);
+    if (pending > backlog) backlog = pending;
+  }
+
+  uint8_t overloaded = (
+    tick_duration > TIME_BETWEEN_TICKS / 4 ||
+    busy_percent > VIEW_GOVERNOR_BUSY_HIGH ||
+    backlog > VIEW_GOVERNOR_BACKLOG
+  );
+  uint8_t headroom = (
+    tick_duration < TIME_BETWEEN_TICKS / 16 &&
+    busy_percent < VIEW_GOVERNOR_BUSY_LOW &&
+    backlog < VIEW_GOVERNOR_BACKLOG / 4
+  );
+  if (!headroom) governor_headroom_time = now;
+  if (governed_distance > view_distance) governed_distance = view_distance;
+
+  if (overloaded) {
+    if (governed_distance <= 2 || now - governor_change_time < VIEW_GOVERNOR_STEP_TIME) return;
+    governed_distance --;
+  } else if (headroom && governed_distance < view_distance) {
+    if (now - governor_headroom_time < VIEW_GOVERNOR_RESTORE_TIME) return;
+    governed_distance ++;
+  } else return;
+
+  // Each further step up needs its own RESTORE_TIME of headroom
+  governor_change_time = now;
+  governor_headroom_time = now;
+  printf(
+    "View governor: sending chunks up to distance %d (tick %lld us, chunk sending %d%%, backlog %zu bytes)\n",
+    governed_distance, (long long)tick_duration, busy_percent, backlog
+  );
+}
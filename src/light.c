@@ -0,0 +1,481 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "tools.h"
+#include "registries.h"
+#include "procedures.h"
+#include "worldgen.h"
+#include "light.h"
+
+// Light lost when passing through each block, 15 means fully opaque.
+static uint8_t light_opacity[256];
+// Light level emitted by each block.
+static uint8_t light_emission[256];
+// Block light solver level each block starts at, see seedSectionEmitters
+static uint8_t light_seed[256];
+static uint8_t light_tables_initialized = false;
+
+// Fills the light tables, call before using them from several threads.
+void initLightTables () {
+  if (light_tables_initialized) return;
+  // Anything not listed here fully blocks light.
+  for (int i = 0; i < 256; i ++) {
+    light_opacity[i] = 15;
+    light_emission[i] = 0;
+  }
+  const uint8_t transparent[] = {
+    B_air, B_torch, B_snow, B_moss_carpet, B_short_grass, B_fern,
+    B_dead_bush, B_oak_sapling, B_lily_pad, B_cactus_flower,
+    B_dandelion, B_poppy, B_allium, B_azure_bluet, B_cornflower,
+    B_oxeye_daisy, B_lily_of_the_valley, B_red_tulip, B_orange_tulip,
+    B_white_tulip, B_pink_tulip, B_red_mushroom, B_brown_mushroom,
+    B_chest
+  };
+  for (size_t i = 0; i < sizeof(transparent); i ++) {
+    light_opacity[transparent[i]] = 0;
+  }
+  const uint8_t filtering[] = {
+    B_oak_leaves, B_azalea_leaves, B_flowering_azalea_leaves, B_ice
+  };
+  for (size_t i = 0; i < sizeof(filtering); i ++) {
+    light_opacity[filtering[i]] = 1;
+  }
+  for (int i = 0; i < 8; i ++) light_opacity[B_water + i] = 1;
+  for (int i = 0; i < 4; i ++) {
+    light_opacity[B_lava + i] = 1;
+    light_emission[B_lava + i] = 15;
+  }
+  light_emission[B_torch] = 14;
+  for (int i = 0; i < 256; i ++) {
+    light_seed[i] = light_opacity[i] == 15 ? 0x80 : light_emission[i];
+  }
+  clearBlockLightCache();
+  light_tables_initialized = true;
+}
+
+uint8_t getBlockLightEmission (uint8_t block) {
+  initLightTables();
+  return light_emission[block];
+}
+
+// Spreads light through a section one level at a time, starting from
+// every block lit above 1. `levels` is in plain (dx + dz * 16 + dy * 256)
+// order, with opaque blocks at 0x80 so that light never enters them.
+// Blocks lit at `level` are final by the time that level is processed,
+// so each block is raised at most once.
+static void spreadLight (uint8_t *levels) {
+  // Lit blocks sorted by level, highest first, then the blocks raised
+  // while spreading, which are queued in order of decreasing level
+  WorldgenContext *context = getWorldgenContext();
+  uint16_t *seeds = context->light_queue[0], *queue = context->light_queue[1];
+  int level_start[17] = { 0 };
+  for (int address = 0; address < 4096; address ++) {
+    uint8_t level = levels[address];
+    if (level > 1 && level <= 15) level_start[level] ++;
+  }
+  for (int level = 15, start = 0; level >= 0; level --) {
+    int count = level_start[level];
+    level_start[level] = start;
+    start += count;
+  }
+  int level_next[16];
+  memcpy(level_next, level_start, sizeof(level_next));
+  for (int address = 0; address < 4096; address ++) {
+    uint8_t level = levels[address];
+    if (level > 1 && level <= 15) seeds[level_next[level] ++] = address;
+  }
+
+  int head = 0, tail = 0;
+  for (int level = 15; level > 1; level --) {
+    uint8_t target = level - 1;
+    int seed = level_start[level], seed_end = level_next[level];
+    int queue_end = tail;
+    while (seed < seed_end || head < queue_end) {
+      int address = seed < seed_end ? seeds[seed ++] : queue[head ++];
+      if (levels[address] != level) continue;
+      int dx = address & 15, dz = (address >> 4) & 15, dy = address >> 8;
+      if (dx > 0 && levels[address - 1] < target) { levels[address - 1] = target; queue[tail ++] = address - 1; }
+      if (dx < 15 && levels[address + 1] < target) { levels[address + 1] = target; queue[tail ++] = address + 1; }
+      if (dz > 0 && levels[address - 16] < target) { levels[address - 16] = target; queue[tail ++] = address - 16; }
+      if (dz < 15 && levels[address + 16] < target) { levels[address + 16] = target; queue[tail ++] = address + 16; }
+      if (dy > 0 && levels[address - 256] < target) { levels[address - 256] = target; queue[tail ++] = address - 256; }
+      if (dy < 15 && levels[address + 256] < target) { levels[address + 256] = target; queue[tail ++] = address + 256; }
+    }
+  }
+}
+
+/**
+ * Propagates sky light through one encoded section: straight down from
+ * the top, then sideways and below overhangs. Light loses a level per
+ * block, except full sky light going down through clear blocks.
+ * `column_level` holds the light entering the top of each column and is
+ * updated in place with the light leaving its bottom, so that light
+ * spread sideways keeps going down into the next section. When `out` is
+ * not NULL, the 2048-byte nibble array is written there. Returns the
+ * section's light range as (min << 4) | max.
+ */
+uint8_t propagateSectionSkyLight (const uint8_t *blocks, uint8_t *column_level, uint8_t *out) {
+  initLightTables();
+  uint8_t *levels = getWorldgenContext()->sky_light_levels;
+  // Range of the blocks that let light in, which it can only spread
+  // across if some are at least two levels apart
+  uint8_t open_min = 15, open_max = 0;
+  for (int dy = 15; dy >= 0; dy --) {
+    for (int column = 0; column < 256; column ++) {
+      unsigned address = (unsigned)column | ((unsigned)dy << 8);
+      uint8_t opacity = light_opacity[blocks[getSectionBlockIndex(address)]];
+      uint8_t level = column_level[column];
+      // Only full sky light goes down through clear blocks undimmed
+      uint8_t loss = opacity == 0 && level != 15 ? 1 : opacity;
+      level = loss >= level ? 0 : level - loss;
+      column_level[column] = level;
+      if (opacity == 15) {
+        levels[address] = 0x80;
+        continue;
+      }
+      levels[address] = level;
+      if (level < open_min) open_min = level;
+      if (level > open_max) open_max = level;
+    }
+  }
+  if (open_max > open_min + 1) {
+    spreadLight(levels);
+    for (int column = 0; column < 256; column ++) column_level[column] = levels[column] & 0x0F;
+  }
+
+  uint8_t min_level = 15, max_level = 0;
+  for (int address = 0; address < 4096; address ++) {
+    uint8_t level = levels[address] & 0x0F;
+    if (level < min_level) min_level = level;
+    if (level > max_level) max_level = level;
+  }
+  if (out != NULL) {
+    for (int i = 0; i < 2048; i ++) {
+      out[i] = (levels[i * 2] & 0x0F) | ((levels[i * 2 + 1] & 0x0F) << 4);
+    }
+  }
+  return (min_level << 4) | max_level;
+}
+
+typedef struct {
+  short x;
+  short z;
+  int8_t y;
+  uint8_t valid;
+  // Next entry in the same bucket, or -1
+  int16_t next;
+  uint8_t light[2048];
+} BlockLightSection;
+
+#define BLOCK_LIGHT_CACHE_BUCKETS (BLOCK_LIGHT_CACHE_SIZE * 2)
+
+// Recently computed block light of sections near emitters. Entries are
+// dropped whenever a block within light range of them changes, and
+// chained by section coordinates from block_light_cache_heads.
+static BlockLightSection block_light_cache[BLOCK_LIGHT_CACHE_SIZE];
+static int16_t block_light_cache_heads[BLOCK_LIGHT_CACHE_BUCKETS];
+static int block_light_cache_next = 0;
+
+// Faces of a section, in the order of the four horizontally adjacent
+// chunks followed by the sections below and above. Opposite faces only
+// differ in the lowest bit.
+#define FACE_WEST 0
+#define FACE_EAST 1
+#define FACE_NORTH 2
+#define FACE_SOUTH 3
+#define FACE_DOWN 4
+#define FACE_UP 5
+
+// Returns the distance from `value` to the inclusive range [min, max].
+static inline int getDistanceToRange (int value, int min, int max) {
+  if (value < min) return min - value;
+  if (value > max) return value - max;
+  return 0;
+}
+
+// Returns the plain (dx + dz * 16 + dy * 256) address of the block at
+// (u, v) on face `face` of a section.
+static inline int getFaceAddress (int face, int u, int v) {
+  switch (face) {
+    case FACE_WEST: return (u << 4) + (v << 8);
+    case FACE_EAST: return 15 + (u << 4) + (v << 8);
+    case FACE_NORTH: return u + (v << 8);
+    case FACE_SOUTH: return u + 240 + (v << 8);
+    case FACE_DOWN: return u + (v << 4);
+    default: return u + (v << 4) + 3840;
+  }
+}
+
+// Marks opaque blocks and seeds emitters of an encoded section into
+// per-block light `levels`, as taken by spreadLight.
+// Returns true if any block emits light.
+static uint8_t seedSectionEmitters (const uint8_t *blocks, uint8_t *levels) {
+  uint8_t emitted = 0;
+  // Walk the blocks in encoded order, getSectionBlockIndex maps both ways
+  for (unsigned index = 0; index < 4096; index ++) {
+    uint8_t level = light_seed[blocks[index]];
+    levels[getSectionBlockIndex(index)] = level;
+    emitted |= level & 0x0F;
+  }
+  return emitted != 0;
+}
+
+// Returns true if any block on face `face` of `levels` lets light in.
+static uint8_t isFaceOpen (const uint8_t *levels, int face) {
+  for (int v = 0; v < 16; v ++) {
+    for (int u = 0; u < 16; u ++) {
+      if (levels[getFaceAddress(face, u, v)] != 0x80) return true;
+    }
+  }
+  return false;
+}
+
+// Copies the light of the blocks on face `face` of `levels` to `out`,
+// indexed by u + v * 16.
+static void copyFaceLevels (const uint8_t *levels, int face, uint8_t *out) {
+  for (int v = 0; v < 16; v ++) {
+    for (int u = 0; u < 16; u ++) {
+      out[u + (v << 4)] = levels[getFaceAddress(face, u, v)];
+    }
+  }
+}
+
+// Same as copyFaceLevels, from a 2048-byte nibble array of light.
+static void copyFaceLight (const uint8_t *light, int face, uint8_t *out) {
+  for (int v = 0; v < 16; v ++) {
+    for (int u = 0; u < 16; u ++) {
+      int address = getFaceAddress(face, u, v);
+      uint8_t pair = light[address >> 1];
+      out[u + (v << 4)] = address & 1 ? pair >> 4 : pair & 0x0F;
+    }
+  }
+}
+
+static int16_t *getBlockLightCacheHead (short x, int8_t y, short z) {
+  uint32_t ux = (uint32_t)(uint16_t)x;
+  uint32_t uz = (uint32_t)(uint16_t)z;
+  uint32_t hash = ux * 73856093u ^ uz * 19349663u ^ (uint32_t)(uint8_t)y * 83492791u;
+  return &block_light_cache_heads[(hash ^ hash >> 13) % BLOCK_LIGHT_CACHE_BUCKETS];
+}
+
+// Returns the index of the cache entry of the section at section
+// coordinates (x, y, z), or -1 if it is not cached.
+static int findBlockLightCacheEntry (short x, int8_t y, short z) {
+  int i = *getBlockLightCacheHead(x, y, z);
+  for (; i != -1; i = block_light_cache[i].next) {
+    BlockLightSection *entry = &block_light_cache[i];
+    if (entry->x == x && entry->y == y && entry->z == z) return i;
+  }
+  return -1;
+}
+
+// Returns the cached block light of the section at section coordinates
+// (x, y, z), or NULL if it is not cached.
+static const uint8_t *findCachedBlockLight (short x, int8_t y, short z) {
+  int i = findBlockLightCacheEntry(x, y, z);
+  return i == -1 ? NULL : block_light_cache[i].light;
+}
+
+// Takes the cache entry at `index` out of its bucket and marks it unused
+static void dropBlockLightCacheEntry (int index) {
+  BlockLightSection *entry = &block_light_cache[index];
+  if (!entry->valid) return;
+  int16_t *link = getBlockLightCacheHead(entry->x, entry->y, entry->z);
+  while (*link != -1 && *link != index) link = &block_light_cache[*link].next;
+  if (*link == index) *link = entry->next;
+  entry->valid = false;
+}
+
+// Lights the blocks on face `face` of `levels` with the light of the
+// blocks they touch in the adjacent section, `face_levels` as written
+// by copyFaceLevels, less one. Returns true if any block was lit.
+static uint8_t seedFromFace (uint8_t *levels, int face, const uint8_t *face_levels) {
+  uint8_t lit = false;
+  for (int i = 0; i < 256; i ++) {
+    uint8_t level = face_levels[i];
+    // Opaque neighbours (0x80) hold no light
+    if (level < 2 || level > 15) continue;
+    int address = getFaceAddress(face, i & 15, i >> 4);
+    if (levels[address] >= level - 1) continue;
+    levels[address] = level - 1;
+    lit = true;
+  }
+  return lit;
+}
+
+/**
+ * Computes block light for the `section_count` sections of the chunk at
+ * block (x, z), the lowest of which starts at y = `base_y`.
+ *
+ * `chunk_blocks` holds the encoded sections one after another, as
+ * produced by buildChunkSection with block changes applied. Light spreads
+ * from every emitter of the terrain or of block changes, through the
+ * actual blocks. Each section is also lit through its faces by the six
+ * adjacent sections, with the light that the emitters within those reach
+ * up to the shared face, or with all of their light where it is cached.
+ * Sections of adjacent chunks are only generated where light can enter
+ * through the face and their terrain or block changes may hold emitters.
+ *
+ * Writes the 2048-byte nibble array of section i to out + i * 2048 if
+ * any light is present there, and returns a mask of those sections.
+ * With a terrain-only worldgen context, block changes and the shared
+ * cache are left alone, so that this may run off the main thread.
+ */
+uint32_t getChunkBlockLight (int x, int z, const uint8_t *chunk_blocks, int section_count, int base_y, uint8_t *out) {
+
+  initLightTables();
+
+  WorldgenContext *context = getWorldgenContext();
+  short chunk_x = div_floor(x, 16);
+  short chunk_z = div_floor(z, 16);
+
+  // Light each section gets from its own emitters, then the light the
+  // adjacent chunks' sections get from theirs, on the faces touching
+  // this chunk, indexed by [side][section]
+  uint8_t *own_levels = malloc((size_t)section_count * (4096 + 4 * 256));
+  if (own_levels == NULL) return 0;
+  uint8_t *side_faces = own_levels + section_count * 4096;
+
+  uint32_t cached = 0, emitting = 0, lit_sections = 0;
+  uint32_t side_lit[4] = { 0, 0, 0, 0 };
+
+  for (int i = 0; i < section_count && !context->terrain_only; i ++) {
+    const uint8_t *light = findCachedBlockLight(chunk_x, div_floor(base_y + i * 16, 16), chunk_z);
+    if (light == NULL) continue;
+    memcpy(out + i * 2048, light, 2048);
+    cached |= 1u << i;
+    lit_sections |= 1u << i;
+  }
+
+  for (int i = 0; i < section_count; i ++) {
+    uint8_t *levels = own_levels + i * 4096;
+    if (!seedSectionEmitters(chunk_blocks + i * 4096, levels)) continue;
+    spreadLight(levels);
+    emitting |= 1u << i;
+  }
+
+  for (int side = FACE_WEST; side <= FACE_SOUTH; side ++) {
+    int neighbor_x = x + (side == FACE_WEST ? -16 : side == FACE_EAST ? 16 : 0);
+    int neighbor_z = z + (side == FACE_NORTH ? -16 : side == FACE_SOUTH ? 16 : 0);
+    short neighbor_chunk_x = div_floor(neighbor_x, 16);
+    short neighbor_chunk_z = div_floor(neighbor_z, 16);
+
+    // Sections of the adjacent chunk holding placed emitters
+    uint32_t placed = 0;
+    for (int i = context->terrain_only ? -1 : firstBlockChangeInChunk(neighbor_chunk_x, neighbor_chunk_z); i != -1; i = nextIndexedBlockChange(i)) {
+      if (light_emission[block_changes[i].block] == 0) continue;
+      if (div_floor(block_changes[i].x, 16) != neighbor_chunk_x) continue;
+      if (div_floor(block_changes[i].z, 16) != neighbor_chunk_z) continue;
+      int section = div_floor(block_changes[i].y - base_y, 16);
+      if (section >= 0 && section < section_count) placed |= 1u << section;
+    }
+
+    for (int i = 0; i < section_count; i ++) {
+      if (cached & (1u << i)) continue;
+      if (!isFaceOpen(own_levels + i * 4096, side)) continue;
+      int y = base_y + i * 16;
+      uint8_t *face = side_faces + (side * section_count + i) * 256;
+      // Light the adjacent section was sent with, which already holds
+      // that of its own emitters along with what reached it from others
+      const uint8_t *light = NULL;
+      if (!context->terrain_only) light = findCachedBlockLight(neighbor_chunk_x, div_floor(y, 16), neighbor_chunk_z);
+      if (light != NULL) {
+        copyFaceLight(light, side ^ 1, face);
+        side_lit[side] |= 1u << i;
+        continue;
+      }
+      if (!(placed & (1u << i)) && !mayTerrainEmitLight(neighbor_x, y, neighbor_z)) continue;
+      buildChunkSection(neighbor_x, y, neighbor_z);
+      uint8_t *levels = context->light_levels;
+      if (!seedSectionEmitters(context->section, levels)) continue;
+      spreadLight(levels);
+      copyFaceLevels(levels, side ^ 1, face);
+      side_lit[side] |= 1u << i;
+    }
+  }
+
+  uint8_t face_levels[256];
+  for (int i = 0; i < section_count; i ++) {
+    if (cached & (1u << i)) continue;
+    uint8_t lit = (emitting >> i) & 1;
+    uint8_t reached = lit;
+    if (i > 0 && (emitting & (1u << (i - 1)))) reached = true;
+    if (i < section_count - 1 && (emitting & (1u << (i + 1)))) reached = true;
+    for (int side = FACE_WEST; side <= FACE_SOUTH; side ++) {
+      if (side_lit[side] & (1u << i)) reached = true;
+    }
+    if (!reached) continue;
+    uint8_t *levels = context->light_levels;
+    memcpy(levels, own_levels + i * 4096, 4096);
+    if (i > 0 && (emitting & (1u << (i - 1)))) {
+      copyFaceLevels(own_levels + (i - 1) * 4096, FACE_UP, face_levels);
+      if (seedFromFace(levels, FACE_DOWN, face_levels)) lit = true;
+    }
+    if (i < section_count - 1 && (emitting & (1u << (i + 1)))) {
+      copyFaceLevels(own_levels + (i + 1) * 4096, FACE_DOWN, face_levels);
+      if (seedFromFace(levels, FACE_UP, face_levels)) lit = true;
+    }
+    for (int side = FACE_WEST; side <= FACE_SOUTH; side ++) {
+      if (!(side_lit[side] & (1u << i))) continue;
+      if (seedFromFace(levels, side, side_faces + (side * section_count + i) * 256)) lit = true;
+    }
+    if (!lit) continue;
+    spreadLight(levels);
+
+    uint8_t *light = out + i * 2048;
+    for (int j = 0; j < 2048; j ++) {
+      light[j] = (levels[j * 2] & 0x0F) | ((levels[j * 2 + 1] & 0x0F) << 4);
+    }
+    lit_sections |= 1u << i;
+    if (context->terrain_only) continue;
+
+    int index = block_light_cache_next;
+    block_light_cache_next = (block_light_cache_next + 1) % BLOCK_LIGHT_CACHE_SIZE;
+    dropBlockLightCacheEntry(index);
+    BlockLightSection *entry = &block_light_cache[index];
+    entry->x = chunk_x;
+    entry->y = div_floor(base_y + i * 16, 16);
+    entry->z = chunk_z;
+    entry->valid = true;
+    int16_t *head = getBlockLightCacheHead(entry->x, entry->y, entry->z);
+    entry->next = *head;
+    *head = index;
+    memcpy(entry->light, light, 2048);
+  }
+
+  free(own_levels);
+  return lit_sections;
+
+}
+
+// Drops all cached block light, as after block changes are loaded.
+void clearBlockLightCache () {
+  for (int i = 0; i < BLOCK_LIGHT_CACHE_SIZE; i ++) {
+    block_light_cache[i].valid = false;
+  }
+  for (int i = 0; i < BLOCK_LIGHT_CACHE_BUCKETS; i ++) {
+    block_light_cache_heads[i] = -1;
+  }
+}
+
+// Drops cached block light of every section that a change at the given
+// coordinates could affect, either by moving an emitter or an occluder.
+// Light reaches at most 14 blocks, so only the sections around the change
+// are looked up, to be recomputed in full on their next send.
+void invalidateBlockLightAt (short x, uint8_t y, short z) {
+  initLightTables();
+  for (int sx = div_floor(x - 14, 16); sx <= div_floor(x + 14, 16); sx ++) {
+    for (int sz = div_floor(z - 14, 16); sz <= div_floor(z + 14, 16); sz ++) {
+      for (int sy = div_floor(y - 14, 16); sy <= div_floor(y + 14, 16); sy ++) {
+        int distance =
+          getDistanceToRange(x, sx * 16, sx * 16 + 15) +
+          getDistanceToRange(y, sy * 16, sy * 16 + 15) +
+          getDistanceToRange(z, sz * 16, sz * 16 + 15);
+        if (distance >= 15) continue;
+        int index = findBlockLightCacheEntry(sx, sy, sz);
+        if (index != -1) dropBlockLightCacheEntry(index);
+      }
+    }
+  }
+}
@@ -41,6 +41,10 @@
 #include "registries.h"
 #include "procedures.h"
 #include "serialize.h"
+#include "chunkstore.h"
+#include "worldbench.h"
+#include "chunkview.h"
+#include "light.h"
 
 static uint8_t templateChunkCompatActive () {
   #ifdef CHUNK_TEMPLATE_VISIBILITY_COMPAT
@@ -351,24 +355,7 @@ void handlePacket (int client_fd, int length, int packet_id, int state) {
           sc_spawnEntityPlayer(client_fd, player_data[i]);
         }
 
-        if (!templateChunkCompatActive()) {
-          // Spawn currently allocated mobs for this client in procedural mode.
-          uint8_t uuid[16];
-          uint32_t r = fast_rand();
-          memcpy(uuid, &r, 4);
-          // Reuse mob index as stable UUID suffix.
-          for (int i = 0; i < MAX_MOBS; i ++) {
-            if (mob_data[i].type == 0) continue;
-            if ((mob_data[i].data & 31) == 0) continue;
-            memcpy(uuid + 4, &i, 4);
-            sc_spawnEntity(
-              client_fd, -2 - i, uuid,
-              mob_data[i].type, mob_data[i].x, mob_data[i].y, mob_data[i].z,
-              0, 0
-            );
-            broadcastMobMetadata(client_fd, -2 - i);
-          }
-        }
+        // Mobs are sent by the server tick once their chunks are loaded
 
       }
       break;
@@ -393,6 +380,10 @@ void handlePacket (int client_fd, int length, int packet_id, int state) {
     case 0x0C: // Client tick (unused).
       break;
 
+    case 0x0D:
+      if (state == STATE_PLAY) cs_clientInformation(client_fd);
+      break;
+
     case 0x0A:
       if (state == STATE_PLAY) cs_chunkBatchReceived(client_fd);
       break;
@@ -538,27 +529,15 @@ void handlePacket (int client_fd, int length, int packet_id, int state) {
         player->x = cx;
         player->y = cy;
         player->z = cz;
+        trackChunkViewMotion(player);
 
         // Stop if player stayed in the same chunk.
         if (dx == 0 && dz == 0) break;
 
-        // Avoid re-sending recently visited chunks.
-        int found = false;
-        for (int i = 0; i < VISITED_HISTORY; i ++) {
-          if (player->visited_x[i] == _x && player->visited_z[i] == _z) {
-            found = true;
-            break;
-          }
-        }
-        if (found) break;
-
-        // Shift visit history and append current chunk.
-        for (int i = 0; i < VISITED_HISTORY - 1; i ++) {
-          player->visited_x[i] = player->visited_x[i + 1];
-          player->visited_z[i] = player->visited_z[i + 1];
-        }
-        player->visited_x[VISITED_HISTORY - 1] = _x;
-        player->visited_z[VISITED_HISTORY - 1] = _z;
+        // Queue chunks that entered view distance, unload those that left.
+        // Streamed by drainChunkQueues.
+        sc_setCenterChunk(client_fd, _x, _z);
+        if (recenterChunkView(player, _x, _z) == 0) break;
 
         if (!templateChunkCompatActive()) {
           // Dynamic mob spawning stays active in procedural mode.
@@ -566,24 +545,37 @@ void handlePacket (int client_fd, int length, int packet_id, int state) {
           uint8_t in_nether_zone = player->z >= NETHER_ZONE_OFFSET;
           // Gate spawn attempts to preserve tick stability.
           if (r % PASSIVE_SPAWN_CHANCE == 0) {
-            // Spawn candidate near chunk edge in movement direction.
-            short mob_x = (_x + dx * view_distance) * 16 + ((r >> 4) & 15);
-            short mob_z = (_z + dz * view_distance) * 16 + ((r >> 8) & 15);
-            // Search upward for a valid spawn column.
+            // Spawn candidate at the simulation distance edge in movement direction.
+            int spawn_distance = getSimulationDistance(player);
+            short mob_x = (_x + dx * spawn_distance) * 16 + ((r >> 4) & 15);
+            short mob_z = (_z + dz * spawn_distance) * 16 + ((r >> 8) & 15);
+            // Search upward for a valid spawn column. There is no ground
+            // above the top solid block, so the column summary settles
+            // the search once it gets there.
             uint8_t mob_y = cy - 8;
-            uint8_t b_low = getBlockAt(mob_x, mob_y - 1, mob_z);
-            uint8_t b_mid = getBlockAt(mob_x, mob_y, mob_z);
-            uint8_t b_top = getBlockAt(mob_x, mob_y + 1, mob_z);
-            while (mob_y < 255) {
-              if ( // Require solid ground and free blocks at feet/head.
-                !isPassableBlock(b_low) &&
-                isPassableSpawnBlock(b_mid) &&
-                isPassableSpawnBlock(b_top)
-              ) break;
-              b_low = b_mid;
-              b_mid = b_top;
-              b_top = getBlockAt(mob_x, mob_y + 2, mob_z);
-              mob_y ++;
+            ColumnSummary column;
+            uint8_t summarized = getColumnSummary(mob_x, mob_z, true, &column);
+            if (summarized && mob_y > column.top_solid) {
+              if (mob_y != column.top_solid + 1 || !(column.flags & COLUMN_SPAWNABLE)) mob_y = 255;
+            } else {
+              uint8_t b_low = getBlockAt(mob_x, mob_y - 1, mob_z);
+              uint8_t b_mid = getBlockAt(mob_x, mob_y, mob_z);
+              uint8_t b_top = getBlockAt(mob_x, mob_y + 1, mob_z);
+              while (mob_y < 255) {
+                if ( // Require solid ground and free blocks at feet/head.
+                  !isPassableBlock(b_low) &&
+                  isPassableSpawnBlock(b_mid) &&
+                  isPassableSpawnBlock(b_top)
+                ) break;
+                if (summarized && mob_y == column.top_solid) {
+                  mob_y = (column.flags & COLUMN_SPAWNABLE) ? mob_y + 1 : 255;
+                  break;
+                }
+                b_low = b_mid;
+                b_mid = b_top;
+                b_top = getBlockAt(mob_x, mob_y + 2, mob_z);
+                mob_y ++;
+              }
             }
             if (mob_y != 255) {
               // Spawn passives by day above ground, hostiles otherwise.
@@ -610,42 +602,6 @@ void handlePacket (int client_fd, int length, int packet_id, int state) {
           }
         }
 
-        int count = 0;
-        #ifdef DEV_LOG_CHUNK_GENERATION
-          printf("Sending new chunks (%d, %d)\n", _x, _z);
-          clock_t start, end;
-          start = clock();
-        #endif
-
-        sc_setCenterChunk(client_fd, _x, _z);
-
-        while (dx != 0) {
-          sc_chunkDataAndUpdateLight(client_fd, _x + dx * view_distance, _z);
-          count ++;
-          for (int i = 1; i <= view_distance; i ++) {
-            sc_chunkDataAndUpdateLight(client_fd, _x + dx * view_distance, _z - i);
-            sc_chunkDataAndUpdateLight(client_fd, _x + dx * view_distance, _z + i);
-            count += 2;
-          }
-          dx += dx > 0 ? -1 : 1;
-        }
-        while (dz != 0) {
-          sc_chunkDataAndUpdateLight(client_fd, _x, _z + dz * view_distance);
-          count ++;
-          for (int i = 1; i <= view_distance; i ++) {
-            sc_chunkDataAndUpdateLight(client_fd, _x - i, _z + dz * view_distance);
-            sc_chunkDataAndUpdateLight(client_fd, _x + i, _z + dz * view_distance);
-            count += 2;
-          }
-          dz += dz > 0 ? -1 : 1;
-        }
-
-        #ifdef DEV_LOG_CHUNK_GENERATION
-          end = clock();
-          double total_ms = (double)(end - start) / CLOCKS_PER_SEC * 1000;
-          printf("Generated %d chunks in %.0f ms (%.2f ms per chunk)\n", count, total_ms, total_ms / (double)count);
-        #endif
-
       }
       break;
 
@@ -745,7 +701,7 @@ static void logDisconnectContext (
 #endif
 }
 
-int main () {
+int main (int argc, char **argv) {
   #ifdef _WIN32 // Initialize WinSock.
     WSADATA wsa;
       if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
@@ -768,10 +724,17 @@ int main () {
   int view_distance_override = 0;
   if (parseIntOverride("NETHR_VIEW_DISTANCE", &view_distance_override)) {
     if (view_distance_override < 2) view_distance_override = 2;
-    if (view_distance_override > 16) view_distance_override = 16;
+    if (view_distance_override > MAX_VIEW_DISTANCE) view_distance_override = MAX_VIEW_DISTANCE;
     view_distance = view_distance_override;
     printf("View distance override: NETHR_VIEW_DISTANCE=%d\n", view_distance);
   }
+  int simulation_distance_override = 0;
+  if (parseIntOverride("NETHR_SIMULATION_DISTANCE", &simulation_distance_override)) {
+    simulation_distance = simulation_distance_override;
+    printf("Simulation distance override: NETHR_SIMULATION_DISTANCE=%d\n", simulation_distance);
+  }
+  if (simulation_distance < 2) simulation_distance = 2;
+  if (simulation_distance > view_distance) simulation_distance = view_distance;
 
   // Hash runtime seeds before first use.
   world_seed = splitmix64(world_seed_raw);
@@ -787,7 +750,7 @@ int main () {
   if (world_spawn_locked) {
     printf("World spawn (from meta): x=%d y=%u z=%d\n", world_spawn_x, world_spawn_y, world_spawn_z);
   }
-  printf("View distance: %d\n", view_distance);
+  printf("View distance: %d, simulation distance: %d\n", view_distance, simulation_distance);
   printf("\n");
 
   // Mark all block-change slots as unused.
@@ -796,6 +759,24 @@ int main () {
   }
   invalidateBlockChangeIndex();
 
+  // Offline pregeneration: `nethr pregen [radius]`.
+  // Runs before block changes are loaded, as the store holds bare terrain.
+  if (argc > 1 && strcmp(argv[1], "pregen") == 0) {
+    int radius = argc > 2 ? atoi(argv[2]) : 32;
+    if (radius < 0) radius = 0;
+    ensureWorldSpawn();
+    saveWorldMeta();
+    return runChunkPregen(radius);
+  }
+
+  // Worldgen benchmark: `nethr bench-worldgen [chunks] [record]`.
+  // Uses its own seed and block changes, and leaves world files alone.
+  if (argc > 1 && strcmp(argv[1], "bench-worldgen") == 0) {
+    int chunk_count = argc > 2 ? atoi(argv[2]) : 256;
+    uint8_t record = argc > 3 && strcmp(argv[3], "record") == 0;
+    return runWorldgenBench(chunk_count, record);
+  }
+
   // Initialize persistence backend when enabled.
   if (initSerializer()) exit(EXIT_FAILURE);
   ensureWorldSpawn();
@@ -906,12 +887,17 @@ int main () {
     // Run server tick at configured interval.
     int64_t time_since_last_tick = get_program_time() - last_tick_time;
     if (time_since_last_tick > TIME_BETWEEN_TICKS) {
+      int64_t tick_start = get_program_time();
       handleServerTick(time_since_last_tick);
       processScheduledJoinLoadMessages();
       flush_all_send_buffers();
       last_tick_time = get_program_time();
+      updateViewGovernor(last_tick_time - tick_start);
     }
 
+    // Stream queued chunks under the global send budget.
+    drainChunkQueues();
+
     // Process one packet from selected client.
     int client_fd = clients[client_index];
     int state = getClientState(client_fd);
@@ -973,6 +959,9 @@ int main () {
         if (i >= block_changes_count) block_changes_count = i + 1;
       }
       invalidateBlockChangeIndex();
+      clearBlockCache();
+      clearChunkSummaries();
+      clearBlockLightCache();
       // Persist imported state.
       writeBlockChangesToDisk(0, block_changes_count);
       writePlayerDataToDisk();
@@ -1047,7 +1036,7 @@ int main () {
 #ifdef ESP_PLATFORM
 
 void nethr_main (void *pvParameters) {
-  main();
+  main(0, NULL);
   vTaskDelete(NULL);
 }
 
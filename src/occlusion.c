@@ -0,0 +1,104 @@
+#include "globals.h"
+
+#ifdef OCCLUDE_HIDDEN_BLOCKS
+
+#include <string.h>
+
+#include "registries.h"
+#include "worldgen.h"
+#include "occlusion.h"
+
+// Returns true for full opaque blocks, which hide the faces of their
+// neighbors. Only the block ID is looked at, so a placed block occludes
+// like a generated one. IDs not listed here count as see-through.
+uint8_t isOccludingBlock (uint8_t block) {
+  switch (block) {
+    case B_stone:
+    case B_cobblestone:
+    case B_dirt:
+    case B_grass_block:
+    case B_snowy_grass_block:
+    case B_sand:
+    case B_sandstone:
+    case B_gravel:
+    case B_mud:
+    case B_bedrock:
+    case B_netherrack:
+    case B_obsidian:
+    case B_coal_ore:
+    case B_iron_ore:
+    case B_copper_ore:
+    case B_gold_ore:
+    case B_redstone_ore:
+    case B_diamond_ore:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Checks the world block at (x, y, z) outside of the chunk being encoded
+static uint8_t isOccludingBlockAt (int x, int y, int z) {
+  // The world above the block change range is always air
+  if (y > 255) return false;
+  return isOccludingBlock(getBlockAt(x, y, z));
+}
+
+/**
+ * Writes the blocks of an encoded section to `out` as they should be sent,
+ * with every occluding block that only touches other occluding blocks
+ * replaced by the most common occluding block of the section.
+ * `below` and `above` are the vertically adjacent sections of the same
+ * chunk, or NULL at the edges of the world. Neighbors in adjacent chunks
+ * are looked up through getBlockAt. (x, y, z) is the section's origin.
+ * Returns the amount of blocks replaced. `out` is only written if that
+ * amount is not zero.
+ */
+int occludeSection (const uint8_t *below, const uint8_t *blocks, const uint8_t *above, int x, int y, int z, uint8_t *out) {
+
+  uint16_t counts[256];
+  memset(counts, 0, sizeof(counts));
+  for (int i = 0; i < 4096; i ++) counts[blocks[i]] ++;
+
+  int dominant = -1;
+  for (int i = 0; i < 256; i ++) {
+    if (counts[i] == 0 || !isOccludingBlock(i)) continue;
+    if (dominant == -1 || counts[i] > counts[dominant]) dominant = i;
+  }
+  if (dominant == -1 || counts[dominant] == 4096) return 0;
+
+  int hidden = 0;
+  for (unsigned address = 0; address < 4096; address ++) {
+    unsigned index = getSectionBlockIndex(address);
+    uint8_t block = blocks[index];
+    if (block == dominant || !isOccludingBlock(block)) continue;
+
+    int dx = address & 15, dz = (address >> 4) & 15, dy = address >> 8;
+
+    if (dy > 0) {
+      if (!isOccludingBlock(blocks[getSectionBlockIndex(address - 256)])) continue;
+    } else if (below == NULL || !isOccludingBlock(below[getSectionBlockIndex(address + 3840)])) continue;
+    if (dy < 15) {
+      if (!isOccludingBlock(blocks[getSectionBlockIndex(address + 256)])) continue;
+    } else if (above == NULL || !isOccludingBlock(above[getSectionBlockIndex(address - 3840)])) continue;
+
+    // Horizontal neighbors within the section first, as they are cheap
+    if (dx > 0 && !isOccludingBlock(blocks[getSectionBlockIndex(address - 1)])) continue;
+    if (dx < 15 && !isOccludingBlock(blocks[getSectionBlockIndex(address + 1)])) continue;
+    if (dz > 0 && !isOccludingBlock(blocks[getSectionBlockIndex(address - 16)])) continue;
+    if (dz < 15 && !isOccludingBlock(blocks[getSectionBlockIndex(address + 16)])) continue;
+    if (dx == 0 && !isOccludingBlockAt(x - 1, y + dy, z + dz)) continue;
+    if (dx == 15 && !isOccludingBlockAt(x + 16, y + dy, z + dz)) continue;
+    if (dz == 0 && !isOccludingBlockAt(x + dx, y + dy, z - 1)) continue;
+    if (dz == 15 && !isOccludingBlockAt(x + dx, y + dy, z + 16)) continue;
+
+    if (hidden == 0) memcpy(out, blocks, 4096);
+    out[index] = dominant;
+    hidden ++;
+  }
+
+  return hidden;
+
+}
+
+#endif
@@ -13,6 +13,9 @@
     #include <ws2tcpip.h>
   #else
     #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
   #endif
   #include <unistd.h>
 #endif
@@ -24,6 +27,11 @@
 #include "worldgen.h"
 #include "crafting.h"
 #include "procedures.h"
+#include "light.h"
+#include "occlusion.h"
+#include "chunkstore.h"
+#include "chunkjobs.h"
+#include "chunkview.h"
 #include "packets.h"
 
 static void writeOverworldContext (int client_fd) {
@@ -53,7 +61,6 @@ static void writeOverworldContext (int client_fd) {
 }
 
 static uint8_t sky_light_full[2048];
-static uint8_t sky_light_dark[2048];
 static uint8_t sky_light_buffers_initialized = false;
 static int8_t template_chunks_enabled_cached = -1;
 
@@ -61,7 +68,6 @@ static void initSkyLightBuffers () {
   if (sky_light_buffers_initialized) return;
   for (int i = 0; i < 2048; i ++) {
     sky_light_full[i] = 0xFF;
-    sky_light_dark[i] = 0x00;
   }
   sky_light_buffers_initialized = true;
 }
@@ -77,12 +83,21 @@ static uint8_t templateChunksEnabled () {
 }
 
 #define CHUNK_TEMPLATE_POOL_MAX 64
-#define CHUNK_TEMPLATE_ASSIGN_CAPACITY 16384
+#define CHUNK_TEMPLATE_ASSIGN_INITIAL 4096
+#ifndef CHUNK_TEMPLATE_ASSIGN_MAX
+  #ifdef ESP_PLATFORM
+    #define CHUNK_TEMPLATE_ASSIGN_MAX 8192
+  #else
+    #define CHUNK_TEMPLATE_ASSIGN_MAX (1 << 20)
+  #endif
+#endif
 #define CHUNK_TEMPLATE_SPAWN_SAFE_RADIUS 3
 
 // Template pool for compatibility mode: we replay known-good Notchian
 // level_chunk_with_light packets and patch only chunk x/z coordinates.
-static uint8_t *chunk_template_0x2c_pool[CHUNK_TEMPLATE_POOL_MAX];
+// Pool entries point either into the mapped template pack or into
+// individually loaded files, and are never written to.
+static const uint8_t *chunk_template_0x2c_pool[CHUNK_TEMPLATE_POOL_MAX];
 static size_t chunk_template_0x2c_pool_len[CHUNK_TEMPLATE_POOL_MAX];
 static int32_t chunk_template_0x2c_src_x[CHUNK_TEMPLATE_POOL_MAX];
 static int32_t chunk_template_0x2c_src_z[CHUNK_TEMPLATE_POOL_MAX];
@@ -96,6 +111,9 @@ static int chunk_template_grid_width = 0;
 static int chunk_template_grid_height = 0;
 static uint8_t chunk_template_grid_complete = false;
 static int16_t chunk_template_grid_lookup[CHUNK_TEMPLATE_POOL_MAX];
+// For each template, the template that continues its source terrain
+// in each direction: 0 = -x, 1 = +x, 2 = -z, 3 = +z. Clamped to the grid.
+static int16_t chunk_template_step[CHUNK_TEMPLATE_POOL_MAX][4];
 static int chunk_template_spawn_anchor_index = -1;
 static int chunk_template_spawn_anchor_gx = 0;
 static int chunk_template_spawn_anchor_gz = 0;
@@ -138,9 +156,99 @@ static int loadChunkTemplateFile (const char *path) {
   return 1;
 }
 
+/**
+ * Template pack layout (all integers big-endian), as written by
+ * scripts/template_refresh.py:
+ *   "NTPK", u32 version (1), u32 count,
+ *   count * { i32 src_x, i32 src_z, u32 offset, u32 length },
+ *   packet bodies at their offsets.
+ * The pack is memory-mapped where possible so templates cost no heap.
+ * Returns the amount of templates added to the pool.
+ */
+static int loadChunkTemplatePack (const char *path) {
+  size_t size = 0;
+  const uint8_t *data = NULL;
+
+  #if !defined(ESP_PLATFORM) && !defined(_WIN32)
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 12) {
+      close(fd);
+      return 0;
+    }
+    size = (size_t)st.st_size;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return 0;
+    data = mapped;
+  #else
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return 0;
+    if (fseek(fp, 0, SEEK_END) != 0) {
+      fclose(fp);
+      return 0;
+    }
+    long file_size = ftell(fp);
+    if (file_size < 12) {
+      fclose(fp);
+      return 0;
+    }
+    rewind(fp);
+    uint8_t *buf = malloc((size_t)file_size);
+    if (buf == NULL) {
+      fclose(fp);
+      return 0;
+    }
+    size = (size_t)file_size;
+    if (fread(buf, 1, size, fp) != size) {
+      fclose(fp);
+      free(buf);
+      return 0;
+    }
+    fclose(fp);
+    data = buf;
+  #endif
+
+  uint32_t count = (uint32_t)readInt32BE(data + 8);
+  if (memcmp(data, "NTPK", 4) != 0 || readInt32BE(data + 4) != 1 || 12 + (size_t)count * 16 > size) {
+    printf("Ignoring invalid chunk template pack \"%s\"\n", path);
+    count = 0;
+  }
+
+  int added = 0;
+  for (uint32_t i = 0; i < count && chunk_template_0x2c_pool_count < CHUNK_TEMPLATE_POOL_MAX; i ++) {
+    const uint8_t *entry = data + 12 + i * 16;
+    size_t offset = (uint32_t)readInt32BE(entry + 8);
+    size_t length = (uint32_t)readInt32BE(entry + 12);
+    if (length < 9 || offset > size || length > size - offset) continue;
+    if (data[offset] != 0x2C) continue;
+    int idx = chunk_template_0x2c_pool_count;
+    chunk_template_0x2c_pool[idx] = data + offset;
+    chunk_template_0x2c_pool_len[idx] = length;
+    chunk_template_0x2c_src_x[idx] = readInt32BE(entry);
+    chunk_template_0x2c_src_z[idx] = readInt32BE(entry + 4);
+    chunk_template_0x2c_pool_count ++;
+    added ++;
+  }
+
+  // Templates reference the pack for the lifetime of the process,
+  // so it is only released if nothing was taken from it.
+  if (added == 0) {
+    #if !defined(ESP_PLATFORM) && !defined(_WIN32)
+      munmap((void *)data, size);
+    #else
+      free((void *)data);
+    #endif
+  }
+  return added;
+}
+
 // Runtime assignment cache:
 // world chunk (x,z) -> chosen template index.
 // We keep this stable so revisits never "flip" terrain variants.
+// Open-addressed, doubled when 3/4 full. Once at CHUNK_TEMPLATE_ASSIGN_MAX,
+// entries far away from the newest chunk are evicted instead.
 typedef struct {
   int32_t x;
   int32_t z;
@@ -148,7 +256,9 @@ typedef struct {
   uint8_t used;
 } ChunkTemplateAssignment;
 
-static ChunkTemplateAssignment chunk_template_assignments[CHUNK_TEMPLATE_ASSIGN_CAPACITY];
+static ChunkTemplateAssignment *chunk_template_assignments = NULL;
+static uint32_t chunk_template_assign_capacity = 0;
+static uint32_t chunk_template_assign_count = 0;
 
 static void writeInt32BE (uint8_t *buf, int32_t v) {
   uint32_t u = (uint32_t)v;
@@ -173,37 +283,102 @@ static uint32_t hashChunkCoord (int32_t x, int32_t z) {
   return ux * 73856093u ^ uz * 19349663u;
 }
 
-static int findChunkTemplateAssignmentSlot (int32_t x, int32_t z, uint8_t create) {
-  uint32_t h = hashChunkCoord(x, z);
-  int first_free = -1;
-  for (int i = 0; i < CHUNK_TEMPLATE_ASSIGN_CAPACITY; i ++) {
-    int slot = (int)((h + (uint32_t)i) % CHUNK_TEMPLATE_ASSIGN_CAPACITY);
-    ChunkTemplateAssignment *entry = &chunk_template_assignments[slot];
-    if (!entry->used) {
-      if (!create) return -1;
-      if (first_free == -1) first_free = slot;
-      break;
+// Returns the slot holding (x, z), or the empty slot where it belongs.
+// Capacity is always a power of two and never full.
+static uint32_t probeChunkTemplateAssignment (ChunkTemplateAssignment *table, uint32_t capacity, int32_t x, int32_t z) {
+  uint32_t mask = capacity - 1;
+  uint32_t slot = hashChunkCoord(x, z) & mask;
+  while (table[slot].used && (table[slot].x != x || table[slot].z != z)) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/**
+ * Moves assignments into a fresh table of the given capacity, keeping
+ * only those within `keep_radius` chunks of (center_x, center_z).
+ * Returns 0 on success, 1 if the new table could not be allocated.
+ */
+static int rehashChunkTemplateAssignments (uint32_t capacity, int32_t center_x, int32_t center_z, int32_t keep_radius) {
+  ChunkTemplateAssignment *table = calloc(capacity, sizeof(ChunkTemplateAssignment));
+  if (table == NULL) return 1;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < chunk_template_assign_capacity; i ++) {
+    ChunkTemplateAssignment *entry = &chunk_template_assignments[i];
+    if (!entry->used) continue;
+    if (
+      entry->x < center_x - keep_radius || entry->x > center_x + keep_radius ||
+      entry->z < center_z - keep_radius || entry->z > center_z + keep_radius
+    ) continue;
+    table[probeChunkTemplateAssignment(table, capacity, entry->x, entry->z)] = *entry;
+    count ++;
+  }
+  free(chunk_template_assignments);
+  chunk_template_assignments = table;
+  chunk_template_assign_capacity = capacity;
+  chunk_template_assign_count = count;
+  return 0;
+}
+
+// Evicts the farthest assignments from (x, z) until at most half of the
+// table remains in use.
+static void evictChunkTemplateAssignments (int32_t x, int32_t z) {
+  int32_t keep_radius = 1 << 14;
+  while (keep_radius > 0) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < chunk_template_assign_capacity; i ++) {
+      ChunkTemplateAssignment *entry = &chunk_template_assignments[i];
+      if (!entry->used) continue;
+      if (
+        entry->x >= x - keep_radius && entry->x <= x + keep_radius &&
+        entry->z >= z - keep_radius && entry->z <= z + keep_radius
+      ) kept ++;
     }
-    if (entry->x == x && entry->z == z) return slot;
+    if (kept <= chunk_template_assign_capacity / 2) break;
+    keep_radius /= 2;
   }
-  if (!create || first_free == -1) return -1;
-  chunk_template_assignments[first_free].used = true;
-  chunk_template_assignments[first_free].x = x;
-  chunk_template_assignments[first_free].z = z;
-  chunk_template_assignments[first_free].template_index = -1;
-  return first_free;
+  uint32_t before = chunk_template_assign_count;
+  // Reuses the current capacity, retry with nothing kept if that fails.
+  if (rehashChunkTemplateAssignments(chunk_template_assign_capacity, x, z, keep_radius)) {
+    memset(chunk_template_assignments, 0, chunk_template_assign_capacity * sizeof(ChunkTemplateAssignment));
+    chunk_template_assign_count = 0;
+  }
+  printf(
+    "Chunk template assignments full, evicted %u entries beyond radius %d of (%d, %d)\n",
+    before - chunk_template_assign_count, keep_radius, x, z
+  );
 }
 
 static int getChunkTemplateAssignment (int32_t x, int32_t z) {
-  int slot = findChunkTemplateAssignmentSlot(x, z, false);
-  if (slot == -1) return -1;
+  if (chunk_template_assignments == NULL) return -1;
+  uint32_t slot = probeChunkTemplateAssignment(chunk_template_assignments, chunk_template_assign_capacity, x, z);
+  if (!chunk_template_assignments[slot].used) return -1;
   return chunk_template_assignments[slot].template_index;
 }
 
 static void setChunkTemplateAssignment (int32_t x, int32_t z, int template_index) {
-  int slot = findChunkTemplateAssignmentSlot(x, z, true);
-  if (slot == -1) return;
-  chunk_template_assignments[slot].template_index = (int16_t)template_index;
+  if (chunk_template_assignments == NULL) {
+    if (rehashChunkTemplateAssignments(CHUNK_TEMPLATE_ASSIGN_INITIAL, x, z, 0)) return;
+  }
+  // Keep the load factor at or below 3/4 so probes stay short
+  if ((chunk_template_assign_count + 1) * 4 > chunk_template_assign_capacity * 3) {
+    uint32_t capacity = chunk_template_assign_capacity * 2;
+    if (
+      capacity > CHUNK_TEMPLATE_ASSIGN_MAX ||
+      rehashChunkTemplateAssignments(capacity, x, z, 0x7FFFFFFF)
+    ) {
+      evictChunkTemplateAssignments(x, z);
+    }
+  }
+  uint32_t slot = probeChunkTemplateAssignment(chunk_template_assignments, chunk_template_assign_capacity, x, z);
+  ChunkTemplateAssignment *entry = &chunk_template_assignments[slot];
+  if (!entry->used) {
+    entry->used = true;
+    entry->x = x;
+    entry->z = z;
+    chunk_template_assign_count ++;
+  }
+  entry->template_index = (int16_t)template_index;
 }
 
 static void templateGridXY (int template_index, int *gx, int *gz) {
@@ -256,12 +431,27 @@ static int selectTemplateForSpawnArea (int32_t world_x, int32_t world_z) {
   return templateIndexAtGrid(want_gx, want_gz);
 }
 
+// Precomputes chunk_template_step from a complete source grid.
+static void buildChunkTemplateStepTable () {
+  const int step_x[4] = { -1, 1, 0, 0 };
+  const int step_z[4] = { 0, 0, -1, 1 };
+  for (int i = 0; i < chunk_template_0x2c_pool_count; i ++) {
+    int gx, gz;
+    templateGridXY(i, &gx, &gz);
+    for (int d = 0; d < 4; d ++) {
+      int want_gx = clampInt(gx + step_x[d], 0, chunk_template_grid_width - 1);
+      int want_gz = clampInt(gz + step_z[d], 0, chunk_template_grid_height - 1);
+      chunk_template_step[i][d] = (int16_t)templateIndexAtGrid(want_gx, want_gz);
+    }
+  }
+}
+
 static int selectTemplateByNeighbors (int32_t world_x, int32_t world_z) {
   if (chunk_template_0x2c_pool_count <= 0) return -1;
 
   // If we cannot reason on a coherent source grid, fallback to deterministic hash.
+  uint32_t h = hashChunkCoord(world_x, world_z);
   if (!chunk_template_grid_complete) {
-    uint32_t h = hashChunkCoord(world_x, world_z);
     return (int)(h % (uint32_t)chunk_template_0x2c_pool_count);
   }
 
@@ -271,81 +461,35 @@ static int selectTemplateByNeighbors (int32_t world_x, int32_t world_z) {
   }
 
   // Neighbor constraints:
-  // left/right/up/down already-assigned chunks provide "ideal" next source cell.
-  int left = getChunkTemplateAssignment(world_x - 1, world_z);
-  int right = getChunkTemplateAssignment(world_x + 1, world_z);
-  int up = getChunkTemplateAssignment(world_x, world_z - 1);
-  int down = getChunkTemplateAssignment(world_x, world_z + 1);
-
-  int best_index = -1;
-  int best_score = 0x7FFFFFFF;
-  uint32_t jitter = hashChunkCoord(world_x, world_z);
-
-  for (int i = 0; i < chunk_template_0x2c_pool_count; i ++) {
+  // each already-assigned neighbor names, through the step table, the
+  // source cell that would continue its terrain into this chunk.
+  // The cell closest to all of them is the one nearest to their mean.
+  const int32_t neighbor_x[4] = { world_x + 1, world_x - 1, world_x, world_x };
+  const int32_t neighbor_z[4] = { world_z, world_z, world_z + 1, world_z - 1 };
+  int sum_gx = 0, sum_gz = 0, constraints = 0, wanted = -1;
+  for (int d = 0; d < 4; d ++) {
+    int neighbor = getChunkTemplateAssignment(neighbor_x[d], neighbor_z[d]);
+    if (neighbor < 0 || neighbor >= chunk_template_0x2c_pool_count) continue;
+    int step = chunk_template_step[neighbor][d];
+    if (step < 0) continue;
+    wanted = step;
     int gx, gz;
-    templateGridXY(i, &gx, &gz);
-    int score = 0;
-    int constraints = 0;
-
-    if (left != -1) {
-      int lgx, lgz;
-      templateGridXY(left, &lgx, &lgz);
-      int want_x = lgx + 1;
-      int want_z = lgz;
-      int dx = gx - want_x;
-      int dz = gz - want_z;
-      score += dx * dx + dz * dz;
-      constraints ++;
-    }
-    if (right != -1) {
-      int rgx, rgz;
-      templateGridXY(right, &rgx, &rgz);
-      int want_x = rgx - 1;
-      int want_z = rgz;
-      int dx = gx - want_x;
-      int dz = gz - want_z;
-      score += dx * dx + dz * dz;
-      constraints ++;
-    }
-    if (up != -1) {
-      int ugx, ugz;
-      templateGridXY(up, &ugx, &ugz);
-      int want_x = ugx;
-      int want_z = ugz + 1;
-      int dx = gx - want_x;
-      int dz = gz - want_z;
-      score += dx * dx + dz * dz;
-      constraints ++;
-    }
-    if (down != -1) {
-      int dgx, dgz;
-      templateGridXY(down, &dgx, &dgz);
-      int want_x = dgx;
-      int want_z = dgz - 1;
-      int dx = gx - want_x;
-      int dz = gz - want_z;
-      score += dx * dx + dz * dz;
-      constraints ++;
-    }
-
-    if (constraints == 0) {
-      // No neighbors yet (frontier start): stable pseudo-random seed.
-      score = (int)((hashChunkCoord(world_x, world_z) + (uint32_t)i * 2654435761u) & 0x7FFF);
-    } else {
-      // Tiny deterministic jitter breaks ties while preserving continuity bias.
-      score += (int)((jitter ^ (uint32_t)i * 1103515245u) & 7u);
-    }
-
-    if (score < best_score) {
-      best_score = score;
-      best_index = i;
-    }
+    templateGridXY(wanted, &gx, &gz);
+    sum_gx += gx;
+    sum_gz += gz;
+    constraints ++;
   }
 
-  if (best_index == -1) {
-    uint32_t h = hashChunkCoord(world_x, world_z);
-    best_index = (int)(h % (uint32_t)chunk_template_0x2c_pool_count);
-  }
+  // No neighbors yet (frontier start): stable pseudo-random seed.
+  if (constraints == 0) return (int)(h % (uint32_t)chunk_template_0x2c_pool_count);
+  if (constraints == 1) return wanted;
+
+  // Round to nearest, using the chunk hash to break exact ties.
+  int round_bias = (int)(h & 1);
+  int gx = (2 * sum_gx + constraints - round_bias) / (2 * constraints);
+  int gz = (2 * sum_gz + constraints - round_bias) / (2 * constraints);
+  int best_index = templateIndexAtGrid(gx, gz);
+  if (best_index == -1) best_index = (int)(h % (uint32_t)chunk_template_0x2c_pool_count);
   return best_index;
 }
 
@@ -354,10 +498,12 @@ static void tryLoadChunkTemplate0x2cPool () {
   if (chunk_template_0x2c_pool_loaded) return;
   chunk_template_0x2c_pool_loaded = true;
 
-  // Load chunk_template_00.bin, chunk_template_01.bin, ... .
+  // Prefer the single memory-mapped pack, then loose files:
+  // chunk_template_00.bin, chunk_template_01.bin, ... .
   // We do not stop at first gap, so a missing file does not disable the pool.
-  int files_found = 0;
-  for (int i = 0; i < CHUNK_TEMPLATE_POOL_MAX; i ++) {
+  int files_found = loadChunkTemplatePack("assets/chunks/chunk_templates.pack");
+  uint8_t pack_loaded = files_found > 0;
+  for (int i = 0; i < CHUNK_TEMPLATE_POOL_MAX && !pack_loaded; i ++) {
     char path[96];
     snprintf(path, sizeof(path), "assets/chunks/chunk_template_%02d.bin", i);
     files_found += loadChunkTemplateFile(path);
@@ -432,11 +578,12 @@ static void tryLoadChunkTemplate0x2cPool () {
     if (chunk_template_spawn_anchor_index >= 0) {
       templateGridXY(chunk_template_spawn_anchor_index, &chunk_template_spawn_anchor_gx, &chunk_template_spawn_anchor_gz);
     }
+    buildChunkTemplateStepTable();
   }
 
   printf(
-    "Loaded notchian chunk template pool (0x2C): %d templates (files_loaded=%d)\n",
-    chunk_template_0x2c_pool_count, files_found
+    "Loaded notchian chunk template pool (0x2C): %d templates (files_loaded=%d, source=%s)\n",
+    chunk_template_0x2c_pool_count, files_found, pack_loaded ? "pack" : "files"
   );
   printf(
     "  Source span: x=[%d..%d] z=[%d..%d], grid=%dx%d, complete=%s, spawn_safe_radius=%d\n",
@@ -647,6 +794,53 @@ static size_t appendVarInt (uint8_t *out, size_t off, uint32_t v) {
   }
 }
 
+/**
+ * Appends the non-air block count and block states of a section, given in
+ * the 8-bit layout of buildChunkSection, as the smallest paletted container:
+ * a single value, or an indirect palette of 4 to 8 bits per block.
+ */
+static size_t appendSectionBlocks (uint8_t *out, size_t off, const uint8_t *blocks) {
+  uint8_t seen[32];
+  uint8_t palette[256];
+  uint8_t palette_index[256];
+  int palette_len = 0;
+  uint16_t non_air = 0;
+  memset(seen, 0, sizeof(seen));
+  for (unsigned address = 0; address < 4096; address ++) {
+    uint8_t block = blocks[getSectionBlockIndex(address)];
+    if (block != B_air) non_air ++;
+    if (seen[block >> 3] & (1 << (block & 7))) continue;
+    seen[block >> 3] |= 1 << (block & 7);
+    palette_index[block] = (uint8_t)palette_len;
+    palette[palette_len ++] = block;
+  }
+
+  off = appendUint16BE(out, off, non_air);
+  if (palette_len == 1) {
+    off = appendByte(out, off, 0);
+    return appendVarInt(out, off, block_palette[palette[0]]);
+  }
+
+  int bits = 4;
+  while ((1 << bits) < palette_len) bits ++;
+  off = appendByte(out, off, (uint8_t)bits);
+  off = appendVarInt(out, off, (uint32_t)palette_len);
+  for (int i = 0; i < palette_len; i ++) {
+    off = appendVarInt(out, off, block_palette[palette[i]]);
+  }
+  // Entries never span two longs, the first one sits in the lowest bits
+  int per_long = 64 / bits;
+  for (unsigned address = 0; address < 4096; address += per_long) {
+    uint64_t packed = 0;
+    for (int i = 0; i < per_long && address + i < 4096; i ++) {
+      uint8_t block = blocks[getSectionBlockIndex(address + i)];
+      packed |= (uint64_t)palette_index[block] << (i * bits);
+    }
+    off = appendUint64BE(out, off, packed);
+  }
+  return off;
+}
+
 static void dumpHex (const char *label, const uint8_t *buf, size_t len) {
   printf("%s (%zu bytes)\n", label, len);
   for (size_t i = 0; i < len; i += 16) {
@@ -740,6 +934,8 @@ int cs_clientInformation (int client_fd) {
   tmp = readByte(client_fd);
   if (recv_count == -1) return 1;
   printf("  View distance: %d\n", tmp);
+  PlayerData *player;
+  if (!getPlayerData(client_fd, &player)) setChunkViewDistance(player, tmp);
   tmp = readVarInt(client_fd);
   if (recv_count == -1) return 1;
   printf("  Chat mode: %d\n", tmp);
@@ -885,6 +1081,13 @@ int sc_loginPlay (int client_fd) {
   };
   int dimension_count = (int)(sizeof(dimensions) / sizeof(dimensions[0]));
   int spawn_dimension_len = (int)strlen(spawn_dimension);
+  int player_view_distance = view_distance;
+  int player_simulation_distance = simulation_distance;
+  PlayerData *player;
+  if (!getPlayerData(client_fd, &player)) {
+    player_view_distance = getChunkViewDistance(player);
+    player_simulation_distance = getSimulationDistance(player);
+  }
   int dimensions_len = 0;
   for (int i = 0; i < dimension_count; i ++) {
     int len = (int)strlen(dimensions[i]);
@@ -905,8 +1108,8 @@ int sc_loginPlay (int client_fd) {
     sizeVarInt(dimension_count) +
     dimensions_len +
     sizeVarInt(MAX_PLAYERS) +
-    sizeVarInt(view_distance) +
-    sizeVarInt(view_distance) +
+    sizeVarInt(player_view_distance) +
+    sizeVarInt(player_simulation_distance) +
     1 + 1 + 1 +
     common_spawn_info_len +
     1;
@@ -932,8 +1135,8 @@ int sc_loginPlay (int client_fd) {
     off += (size_t)len;
   }
   off = appendVarInt(login_dbg, off, MAX_PLAYERS);
-  off = appendVarInt(login_dbg, off, view_distance);
-  off = appendVarInt(login_dbg, off, view_distance);
+  off = appendVarInt(login_dbg, off, player_view_distance);
+  off = appendVarInt(login_dbg, off, player_simulation_distance);
   off = appendByte(login_dbg, off, 0);
   off = appendByte(login_dbg, off, true);
   off = appendByte(login_dbg, off, false);
@@ -974,9 +1177,9 @@ int sc_loginPlay (int client_fd) {
   // Maxplayers
   writeVarInt(client_fd, MAX_PLAYERS);
   // View distance
-  writeVarInt(client_fd, view_distance);
+  writeVarInt(client_fd, player_view_distance);
   // Sim distance
-  writeVarInt(client_fd, view_distance);
+  writeVarInt(client_fd, player_simulation_distance);
   // Reduced debug info
   writeByte(client_fd, 0);
   // Respawn screen
@@ -1105,43 +1308,57 @@ int sc_setCenterChunk (int client_fd, int x, int y) {
   return 0;
 }
 
-// S->C Chunk Data and Update Light
-int sc_chunkDataAndUpdateLight (int client_fd, int _x, int _z) {
-  tryLoadChunkTemplate0x2cPool();
-  if (chunk_template_0x2c_pool_count > 0) {
-    // Assign once per world chunk and reuse forever in this process.
-    int template_index = getChunkTemplateAssignment(_x, _z);
-    if (template_index < 0 || template_index >= chunk_template_0x2c_pool_count) {
-      template_index = selectTemplateByNeighbors(_x, _z);
-      setChunkTemplateAssignment(_x, _z, template_index);
-    }
-    size_t body_len = chunk_template_0x2c_pool_len[template_index];
-    uint8_t *body = malloc(body_len);
-    if (body == NULL) return 1;
-    memcpy(body, chunk_template_0x2c_pool[template_index], body_len);
-    // Packet body layout starts with: id(0x2C), chunk_x(i32), chunk_z(i32)
-    writeInt32BE(body + 1, _x);
-    writeInt32BE(body + 5, _z);
+// S->C Unload Chunk
+int sc_forgetLevelChunk (int client_fd, int x, int z) {
+  writeVarInt(client_fd, 9);
+  // 1.21.11: play/clientbound forget_level_chunk
+  writeByte(client_fd, 0x25);
+  // Chunk position as a Long, Z in the high half
+  writeUint32(client_fd, z);
+  writeUint32(client_fd, x);
+  return 0;
+}
 
-    static uint8_t logged_once = false;
-    if (!logged_once) {
-      printf(
-        "Chunk encoder v7: using notchian 0x2C template pool (%d variants), grid_complete=%s, sample_body_len=%zu\n\n",
-        chunk_template_0x2c_pool_count, chunk_template_grid_complete ? "yes" : "no", body_len
-      );
-      logged_once = true;
-    }
+// S->C Set Render Distance
+int sc_setChunkCacheRadius (int client_fd, int radius) {
+  writeVarInt(client_fd, 1 + sizeVarInt(radius));
+  // 1.21.11: play/clientbound set_chunk_cache_radius
+  writeByte(client_fd, 0x5D);
+  writeVarInt(client_fd, radius);
+  return 0;
+}
 
-    writeVarInt(client_fd, (uint32_t)body_len);
-    send_all(client_fd, body, (ssize_t)body_len);
-    free(body);
-    return 0;
-  }
+// S->C Chunk Batch Start
+int sc_chunkBatchStart (int client_fd) {
+  writeVarInt(client_fd, 1);
+  // 1.21.11: play/clientbound chunk_batch_start
+  writeByte(client_fd, 0x0C);
+  return 0;
+}
+
+// S->C Chunk Batch Finished
+int sc_chunkBatchFinished (int client_fd, int batch_size) {
+  writeVarInt(client_fd, 1 + sizeVarInt(batch_size));
+  // 1.21.11: play/clientbound chunk_batch_finished
+  writeByte(client_fd, 0x0B);
+  writeVarInt(client_fd, batch_size);
+  return 0;
+}
 
+// Prepares the lazily built tables used by buildChunkPacketBody.
+// Must run before chunks are encoded off the main thread.
+void initChunkPacketEncoder () {
   initSkyLightBuffers();
-  // Build the whole packet body in memory so all dynamic lengths are exact.
-  uint8_t *body = malloc(220000);
-  if (body == NULL) return 1;
+  initLightTables();
+}
+
+// Encodes the procedural level_chunk_with_light packet body for chunk
+// (_x, _z) into `body`, which must hold CHUNK_PACKET_BODY_MAX bytes.
+// Uses the calling thread's worldgen context for scratch state.
+// Returns the body length, or 0 if scratch memory could not be allocated.
+size_t buildChunkPacketBody (uint8_t *body, int _x, int _z) {
+  initSkyLightBuffers();
+  WorldgenContext *context = getWorldgenContext();
   size_t body_off = 0;
 
   // 1.21.11: play/clientbound level_chunk_with_light
@@ -1151,12 +1368,10 @@ int sc_chunkDataAndUpdateLight (int client_fd, int _x, int _z) {
   // Heightmaps NBT omitted.
   body_off = appendVarInt(body, body_off, 0);
 
-  uint8_t *chunk_data = malloc(130000);
-  if (chunk_data == NULL) {
-    free(body);
-    return 1;
-  }
-  size_t chunk_data_off = 0;
+  // Raw blocks of every section, kept around for the light passes below
+  uint8_t *chunk_blocks = malloc(24 * 4096);
+  if (chunk_blocks == NULL) return 0;
+  uint8_t biomes[24];
   int x = _x * 16, z = _z * 16, y;
 
   // Overworld dimension_type defines minY=-64, height=384 => 24 sections.
@@ -1164,56 +1379,212 @@ int sc_chunkDataAndUpdateLight (int client_fd, int _x, int _z) {
   const int section_base_y = -64;
   for (int i = 0; i < section_count; i ++) {
     y = section_base_y + i * 16;
-    chunk_data_off = appendUint16BE(chunk_data, chunk_data_off, 4096);
-    chunk_data_off = appendByte(chunk_data, chunk_data_off, 8);     // block bits
-    chunk_data_off = appendVarInt(chunk_data, chunk_data_off, 256); // palette length
-    memcpy(chunk_data + chunk_data_off, network_block_palette, sizeof(network_block_palette));
-    chunk_data_off += sizeof(network_block_palette);
-    // 1.21.11 PalettedContainer: data-array length is implicit (not serialized).
-    // 4096 blocks @ 8 bits per block -> 512 longs -> 4096 packed bytes.
-    uint8_t biome = buildChunkSection(x, y, z);
-    memcpy(chunk_data + chunk_data_off, chunk_section, 4096);
-    chunk_data_off += 4096;
-    chunk_data_off = appendByte(chunk_data, chunk_data_off, 0);     // biome bits
-    chunk_data_off = appendVarInt(chunk_data, chunk_data_off, biome);
-    // bits=0 container stores only the single value (no data-array length).
+    biomes[i] = buildChunkSection(x, y, z);
+    memcpy(chunk_blocks + i * 4096, context->section, 4096);
     task_yield();
   }
 
-  body_off = appendVarInt(body, body_off, (uint32_t)chunk_data_off);
-  memcpy(body + body_off, chunk_data, chunk_data_off);
-  body_off += chunk_data_off;
-  free(chunk_data);
+  // Chunk data is written in place, after room for its VarInt length,
+  // and moved back once the length is known.
+  size_t chunk_data_start = body_off + 3;
+  size_t chunk_data_off = chunk_data_start;
+  for (int i = 0; i < section_count; i ++) {
+    y = section_base_y + i * 16;
+    const uint8_t *blocks = chunk_blocks + i * 4096;
+    #ifdef OCCLUDE_HIDDEN_BLOCKS
+    const uint8_t *below = i > 0 ? blocks - 4096 : NULL;
+    const uint8_t *above = i < section_count - 1 ? blocks + 4096 : NULL;
+    if (occludeSection(below, blocks, above, x, y, z, context->visible_section)) {
+      blocks = context->visible_section;
+    }
+    #endif
+    chunk_data_off = appendSectionBlocks(body, chunk_data_off, blocks);
+    chunk_data_off = appendByte(body, chunk_data_off, 0);     // biome bits
+    chunk_data_off = appendVarInt(body, chunk_data_off, biomes[i]);
+    // bits=0 container stores only the single value (no data-array length).
+  }
+
+  size_t chunk_data_len = chunk_data_off - chunk_data_start;
+  body_off = appendVarInt(body, body_off, (uint32_t)chunk_data_len);
+  memmove(body + body_off, body + chunk_data_start, chunk_data_len);
+  body_off += chunk_data_len;
 
+  #ifdef ALLOW_CHESTS
+  // Chests need a block entity on the client to render.
+  uint32_t block_entity_count = 0;
+  for (int i = context->terrain_only ? -1 : firstBlockChangeInChunk(_x, _z); i != -1; i = nextIndexedBlockChange(i)) {
+    if (block_changes[i].block != B_chest) continue;
+    if (div_floor(block_changes[i].x, 16) != _x) continue;
+    if (div_floor(block_changes[i].z, 16) != _z) continue;
+    block_entity_count ++;
+  }
+  body_off = appendVarInt(body, body_off, block_entity_count);
+  for (int i = context->terrain_only ? -1 : firstBlockChangeInChunk(_x, _z); i != -1; i = nextIndexedBlockChange(i)) {
+    if (block_changes[i].block != B_chest) continue;
+    if (div_floor(block_changes[i].x, 16) != _x) continue;
+    if (div_floor(block_changes[i].z, 16) != _z) continue;
+    body_off = appendByte(body, body_off, ((block_changes[i].x & 15) << 4) | (block_changes[i].z & 15));
+    body_off = appendUint16BE(body, body_off, block_changes[i].y);
+    body_off = appendVarInt(body, body_off, BLOCK_ENTITY_TYPE_CHEST);
+    // Empty nameless compound tag
+    body_off = appendByte(body, body_off, 0x0A);
+    body_off = appendByte(body, body_off, 0x00);
+  }
+  #else
   // Omit block entities.
   body_off = appendVarInt(body, body_off, 0);
+  #endif
 
   // Light data for minY=-64,height=384:
   // section count is 24 and light uses section+2 => 26 layers.
-  const uint64_t sky_full_mask = 0x03FFFFFFULL; // 26 one-bits
-  const uint32_t sky_updates = 26;
+  // Layers above the highest non-full layer are omitted, since the client
+  // treats missing layers above the data as open sky. Fully dark layers
+  // are flagged in empty_sky_y_mask. Only the remaining layers carry an
+  // array, computed top-down from the encoded blocks.
+  uint8_t (*entry_level)[256] = context->sky_entry_level;
+  uint8_t column_level[256];
+  uint8_t section_range[24];
+  uint64_t sky_mask = 0, empty_sky_mask = 1; // layer 0 is below the world
+  uint8_t open_sky = true;
+  memset(column_level, 15, sizeof(column_level));
+  for (int i = section_count - 1; i >= 0; i --) {
+    memcpy(entry_level[i], column_level, 256);
+    uint8_t range = propagateSectionSkyLight(chunk_blocks + i * 4096, column_level, NULL);
+    section_range[i] = range;
+    if (range == 0xFF && open_sky) continue;
+    open_sky = false;
+    if (range == 0x00) empty_sky_mask |= 1ULL << (i + 1);
+    else sky_mask |= 1ULL << (i + 1);
+  }
+  uint32_t sky_updates = (uint32_t)__builtin_popcountll(sky_mask);
+
+  // Block light is only sent for sections reached by an emitter.
+  // Arrays are collected up front, since the mask precedes the sky data.
+  uint8_t *block_light = malloc(section_count * 2048);
+  uint64_t block_mask = 0;
+  if (block_light != NULL) {
+    block_mask = (uint64_t)getChunkBlockLight(x, z, chunk_blocks, section_count, section_base_y, block_light) << 1;
+  }
+  uint32_t block_updates = (uint32_t)__builtin_popcountll(block_mask);
+
   body_off = appendVarInt(body, body_off, 1); // sky_y_mask long count
-  body_off = appendUint64BE(body, body_off, sky_full_mask);
-  body_off = appendVarInt(body, body_off, 0); // block_y_mask long count
-  body_off = appendVarInt(body, body_off, 0); // empty_sky_y_mask long count
+  body_off = appendUint64BE(body, body_off, sky_mask);
+  if (block_mask) {
+    body_off = appendVarInt(body, body_off, 1); // block_y_mask long count
+    body_off = appendUint64BE(body, body_off, block_mask);
+  } else {
+    body_off = appendVarInt(body, body_off, 0); // block_y_mask long count
+  }
+  body_off = appendVarInt(body, body_off, 1); // empty_sky_y_mask long count
+  body_off = appendUint64BE(body, body_off, empty_sky_mask);
   body_off = appendVarInt(body, body_off, 0); // empty_block_y_mask long count
   body_off = appendVarInt(body, body_off, sky_updates);
-  for (uint32_t i = 0; i < sky_updates; i ++) {
+  for (int i = 0; i < section_count; i ++) {
+    if (!(sky_mask & (1ULL << (i + 1)))) continue;
+    body_off = appendVarInt(body, body_off, 2048);
+    if (section_range[i] == 0xFF) memcpy(body + body_off, sky_light_full, 2048);
+    else propagateSectionSkyLight(chunk_blocks + i * 4096, entry_level[i], body + body_off);
+    body_off += 2048;
+  }
+  body_off = appendVarInt(body, body_off, block_updates);
+  for (int i = 0; i < section_count; i ++) {
+    if (!(block_mask & (1ULL << (i + 1)))) continue;
     body_off = appendVarInt(body, body_off, 2048);
-    memcpy(body + body_off, sky_light_full, 2048);
+    memcpy(body + body_off, block_light + i * 2048, 2048);
     body_off += 2048;
   }
-  body_off = appendVarInt(body, body_off, 0); // block_updates
+  free(block_light);
+  free(chunk_blocks);
 
   static uint8_t logged_once = false;
-  if (!logged_once) {
+  if (!logged_once && !context->terrain_only) {
     printf(
-      "Chunk encoder v8: packet_id=0x2C body_len=%zu chunk_data_len=%zu light_mode=sky_full26 sections=%d y=[%d..%d] (procedural)\n\n",
-      body_off, chunk_data_off, section_count, section_base_y, section_base_y + section_count * 16 - 1
+      "Chunk encoder v8: packet_id=0x2C body_len=%zu chunk_data_len=%zu light_mode=sky_masked(%d)+block(%d) sections=%d y=[%d..%d] (procedural)\n\n",
+      body_off, chunk_data_len, (int)sky_updates, (int)block_updates, section_count, section_base_y, section_base_y + section_count * 16 - 1
     );
     logged_once = true;
   }
 
+  return body_off;
+
+}
+
+// Returns true if chunk (_x, _z) can be sent right away, or false if
+// it is still being generated by the chunk job pool.
+uint8_t isChunkPacketReady (int _x, int _z) {
+  tryLoadChunkTemplate0x2cPool();
+  if (chunk_template_0x2c_pool_count > 0) return true;
+  size_t stored_len;
+  if (getStoredChunkBody(_x, _z, &stored_len) != NULL) return true;
+  // Modified chunks are always encoded on the main thread
+  if (hasBlockChangesNear(_x, _z)) return true;
+  return isChunkJobReady(_x, _z);
+}
+
+// S->C Chunk Data and Update Light
+int sc_chunkDataAndUpdateLight (int client_fd, int _x, int _z) {
+  tryLoadChunkTemplate0x2cPool();
+  if (chunk_template_0x2c_pool_count > 0) {
+    // Assign once per world chunk and reuse forever in this process.
+    int template_index = getChunkTemplateAssignment(_x, _z);
+    if (template_index < 0 || template_index >= chunk_template_0x2c_pool_count) {
+      template_index = selectTemplateByNeighbors(_x, _z);
+      setChunkTemplateAssignment(_x, _z, template_index);
+    }
+    size_t body_len = chunk_template_0x2c_pool_len[template_index];
+    const uint8_t *body = chunk_template_0x2c_pool[template_index];
+
+    static uint8_t logged_once = false;
+    if (!logged_once) {
+      printf(
+        "Chunk encoder v7: using notchian 0x2C template pool (%d variants), grid_complete=%s, sample_body_len=%zu\n\n",
+        chunk_template_0x2c_pool_count, chunk_template_grid_complete ? "yes" : "no", body_len
+      );
+      logged_once = true;
+    }
+
+    // Packet body layout starts with: id(0x2C), chunk_x(i32), chunk_z(i32)
+    // Only the coordinates are patched, the rest is sent from the pool.
+    uint8_t header[9];
+    header[0] = body[0];
+    writeInt32BE(header + 1, _x);
+    writeInt32BE(header + 5, _z);
+    writeVarInt(client_fd, (uint32_t)body_len);
+    send_all(client_fd, header, sizeof(header));
+    send_all(client_fd, body + 9, (ssize_t)(body_len - 9));
+    return 0;
+  }
+
+  // Unmodified chunks are replayed from the pregenerated store.
+  size_t stored_len = 0;
+  const uint8_t *stored = getStoredChunkBody(_x, _z, &stored_len);
+  if (stored != NULL) {
+    writeVarInt(client_fd, (uint32_t)stored_len);
+    send_all(client_fd, stored, (ssize_t)stored_len);
+    return 0;
+  }
+
+  // Worker bodies are bare terrain, so they are only valid as long as
+  // no blocks were changed near the chunk in the meantime.
+  size_t job_len = 0;
+  uint8_t *job_body = takeChunkJobBody(_x, _z, &job_len);
+  if (job_body != NULL && !hasBlockChangesNear(_x, _z)) {
+    writeVarInt(client_fd, (uint32_t)job_len);
+    send_all(client_fd, job_body, (ssize_t)job_len);
+    free(job_body);
+    return 0;
+  }
+  free(job_body);
+
+  // Build the whole packet body in memory so all dynamic lengths are exact.
+  uint8_t *body = malloc(CHUNK_PACKET_BODY_MAX);
+  if (body == NULL) return 1;
+  size_t body_off = buildChunkPacketBody(body, _x, _z);
+  if (body_off == 0) {
+    free(body);
+    return 1;
+  }
+
   writeVarInt(client_fd, (uint32_t)body_off);
   send_all(client_fd, body, (ssize_t)body_off);
 
@@ -1233,21 +1604,6 @@ int sc_chunkDataAndUpdateLight (int client_fd, int _x, int _z) {
   }
   free(body);
 
-  // Sending block updates changes light prediciton on the client.
-  // Light-emitting blocks are omitted from chunk data so that they can
-  // Be overlayed here. This seems to be cheaper than sending actual
-  // Block light data.
-  for (int i = firstBlockChangeInChunk(_x, _z); i != -1; i = nextIndexedBlockChange(i)) {
-    if (div_floor(block_changes[i].x, 16) != _x) continue;
-    if (div_floor(block_changes[i].z, 16) != _z) continue;
-    #ifdef ALLOW_CHESTS
-      if (block_changes[i].block != B_torch && block_changes[i].block != B_chest) continue;
-    #else
-      if (block_changes[i].block != B_torch) continue;
-    #endif
-    sc_blockUpdate(client_fd, block_changes[i].x, block_changes[i].y, block_changes[i].z, block_changes[i].block);
-  }
-
   return 0;
 
 }
@@ -2251,6 +2607,9 @@ int cs_chunkBatchReceived (int client_fd) {
   #ifdef DEV_LOG_UNKNOWN_PACKETS
     printf("Play RX: chunk_batch_received desiredChunksPerTick=%.2f\n", desired);
   #endif
+  PlayerData *player;
+  if (getPlayerData(client_fd, &player)) return 1;
+  handleChunkBatchReceived(player, desired);
   return 0;
 }
 
@@ -15,6 +15,9 @@
 #include "structures.h"
 #include "serialize.h"
 #include "procedures.h"
+#include "light.h"
+#include "occlusion.h"
+#include "chunkview.h"
 
 int client_states[MAX_PLAYERS * 2];
 
@@ -73,14 +76,11 @@ static uint8_t isSpawnAreaPlayable (int x, int y, int z) {
   int water_cells = 0;
   for (int dz = -4; dz <= 4; dz += 2) {
     for (int dx = -4; dx <= 4; dx += 2) {
-      int sx = x + dx;
-      int sz = z + dz;
-      uint8_t h = getHeightAt(sx, sz);
-      uint8_t top = getBlockAt(sx, h, sz);
-      uint8_t above = getBlockAt(sx, h + 1, sz);
-      if (!isPassableBlock(top) && above == B_air && h >= 63) {
+      ColumnSummary column;
+      if (!getColumnSummary(x + dx, z + dz, true, &column)) continue;
+      if (column.flags & COLUMN_DRY_LAND) {
         land_cells++;
-      } else if (above == B_water || top == B_water) {
+      } else if (column.flags & COLUMN_WET) {
         water_cells++;
       }
     }
@@ -137,26 +137,17 @@ void ensureWorldSpawn () {
 
         int wx = center_x + x;
         int wz = center_z + z;
-        uint8_t y = getHeightAt(wx, wz);
+        ColumnSummary column;
+        if (!getColumnSummary(wx, wz, false, &column)) continue;
+        uint8_t y = column.height;
         if (y < 60 || y > 96) continue;
 
-        if (!isSpawnAreaPlayable(wx, y + 1, wz)) continue;
-
-        uint8_t h_n = getHeightAt(wx, wz - 1);
-        uint8_t h_s = getHeightAt(wx, wz + 1);
-        uint8_t h_w = getHeightAt(wx - 1, wz);
-        uint8_t h_e = getHeightAt(wx + 1, wz);
-        uint8_t h_min = h_n;
-        uint8_t h_max = h_n;
-        if (h_s < h_min) h_min = h_s;
-        if (h_w < h_min) h_min = h_w;
-        if (h_e < h_min) h_min = h_e;
-        if (h_s > h_max) h_max = h_s;
-        if (h_w > h_max) h_max = h_w;
-        if (h_e > h_max) h_max = h_e;
-        int slope = (int)h_max - (int)h_min;
+        // Cheap slope check first, the area check inspects blocks
+        int slope = column.slope;
         if (slope > 4) continue;
 
+        if (!isSpawnAreaPlayable(wx, y + 1, wz)) continue;
+
         uint8_t biome = getChunkBiome(div_floor(wx, CHUNK_SIZE), div_floor(wz, CHUNK_SIZE));
         if (biome == W_beach) continue;
 
@@ -268,23 +259,28 @@ void ensureWorldSpawn () {
 }
 
 #define BLOCK_CHANGE_BUCKETS 1024
-
+#define BLOCK_CHANGE_COORD_BUCKETS 8192
+#define BLOCK_CHANGE_FREE_WORDS ((MAX_BLOCK_CHANGES + 63) / 64)
+
+/**
+ * Indexes of block_changes, updated in place by storeBlockChange and
+ * rebuilt from scratch only after invalidateBlockChangeIndex:
+ *   doubly linked lists of the entries in the chunks of each chunk bucket,
+ *   lists of the entries at the coordinates of each coordinate bucket,
+ *   a bitmap of free slots, summarized once more per 64-slot word.
+ * The slots of chest item data are neither indexed nor free.
+ */
 static int16_t block_change_bucket_heads[BLOCK_CHANGE_BUCKETS];
 static int16_t block_change_next[MAX_BLOCK_CHANGES];
-static uint8_t block_change_index_initialized = false;
+static int16_t block_change_prev[MAX_BLOCK_CHANGES];
+static int16_t block_change_coord_heads[BLOCK_CHANGE_COORD_BUCKETS];
+static int16_t block_change_coord_next[MAX_BLOCK_CHANGES];
+// One bit per slot, set while the slot is free
+static uint64_t block_change_free[BLOCK_CHANGE_FREE_WORDS];
+// One bit per word of block_change_free, set while it has a free slot
+static uint64_t block_change_free_words[(BLOCK_CHANGE_FREE_WORDS + 63) / 64];
 static uint8_t block_change_index_dirty = true;
 
-static void initBlockChangeIndexStorage () {
-  if (block_change_index_initialized) return;
-  for (int i = 0; i < BLOCK_CHANGE_BUCKETS; i ++) {
-    block_change_bucket_heads[i] = -1;
-  }
-  for (int i = 0; i < MAX_BLOCK_CHANGES; i ++) {
-    block_change_next[i] = -1;
-  }
-  block_change_index_initialized = true;
-}
-
 static uint16_t getBlockChangeBucket (short chunk_x, short chunk_z) {
   uint32_t ux = (uint32_t)(uint16_t)chunk_x;
   uint32_t uz = (uint32_t)(uint16_t)chunk_z;
@@ -292,33 +288,90 @@ static uint16_t getBlockChangeBucket (short chunk_x, short chunk_z) {
   return (uint16_t)(hash & (BLOCK_CHANGE_BUCKETS - 1));
 }
 
+static uint16_t getBlockChangeCoordBucket (short x, uint8_t y, short z) {
+  uint32_t ux = (uint32_t)(uint16_t)x;
+  uint32_t uz = (uint32_t)(uint16_t)z;
+  uint32_t hash = ux * 73856093u ^ uz * 19349663u ^ y * 83492791u;
+  return (uint16_t)((hash ^ hash >> 13) & (BLOCK_CHANGE_COORD_BUCKETS - 1));
+}
+
+static int16_t *getBlockChangeBucketHead (int index) {
+  short chunk_x = div_floor(block_changes[index].x, 16);
+  short chunk_z = div_floor(block_changes[index].z, 16);
+  return &block_change_bucket_heads[getBlockChangeBucket(chunk_x, chunk_z)];
+}
+
+static int16_t *getBlockChangeCoordHead (int index) {
+  BlockChange *change = &block_changes[index];
+  return &block_change_coord_heads[getBlockChangeCoordBucket(change->x, change->y, change->z)];
+}
+
+// Adds the entry at `index` to the chunk and coordinate indexes
+static void linkBlockChange (int index) {
+  int16_t *head = getBlockChangeBucketHead(index);
+  block_change_prev[index] = -1;
+  block_change_next[index] = *head;
+  if (*head != -1) block_change_prev[*head] = index;
+  *head = index;
+  head = getBlockChangeCoordHead(index);
+  block_change_coord_next[index] = *head;
+  *head = index;
+}
+
+// Takes the entry at `index` out of the chunk and coordinate indexes.
+// Chunk lists can be long, so they are unlinked through block_change_prev.
+// Coordinate chains only hold the few entries that share a bucket.
+static void unlinkBlockChange (int index) {
+  int16_t prev = block_change_prev[index], next = block_change_next[index];
+  if (prev != -1) block_change_next[prev] = next;
+  else *getBlockChangeBucketHead(index) = next;
+  if (next != -1) block_change_prev[next] = prev;
+  int16_t *link = getBlockChangeCoordHead(index);
+  while (*link != -1 && *link != index) link = &block_change_coord_next[*link];
+  if (*link == index) *link = block_change_coord_next[index];
+}
+
+static void setBlockChangeSlotFree (int index, uint8_t free) {
+  int word = index / 64;
+  uint64_t bit = 1ull << (index % 64);
+  if (free) block_change_free[word] |= bit;
+  else block_change_free[word] &= ~bit;
+  uint64_t word_bit = 1ull << (word % 64);
+  if (block_change_free[word]) block_change_free_words[word / 64] |= word_bit;
+  else block_change_free_words[word / 64] &= ~word_bit;
+}
+
 static void rebuildBlockChangeIndex () {
-  initBlockChangeIndexStorage();
 
   for (int i = 0; i < BLOCK_CHANGE_BUCKETS; i ++) {
     block_change_bucket_heads[i] = -1;
   }
-  for (int i = 0; i < block_changes_count; i ++) {
-    block_change_next[i] = -1;
+  for (int i = 0; i < BLOCK_CHANGE_COORD_BUCKETS; i ++) {
+    block_change_coord_heads[i] = -1;
+  }
+  memset(block_change_free_words, 0, sizeof(block_change_free_words));
+  for (int i = 0; i < BLOCK_CHANGE_FREE_WORDS; i ++) {
+    block_change_free[i] = 0;
+    // Slots past MAX_BLOCK_CHANGES in the last word are never free
+    int slots = MAX_BLOCK_CHANGES - i * 64;
+    for (int j = 0; j < 64 && j < slots; j ++) setBlockChangeSlotFree(i * 64 + j, true);
   }
 
   for (int i = 0; i < block_changes_count; i ++) {
     uint8_t block = block_changes[i].block;
     if (block == 0xFF) continue;
-
-    short chunk_x = div_floor(block_changes[i].x, 16);
-    short chunk_z = div_floor(block_changes[i].z, 16);
-    uint16_t bucket = getBlockChangeBucket(chunk_x, chunk_z);
-
-    block_change_next[i] = block_change_bucket_heads[bucket];
-    block_change_bucket_heads[bucket] = i;
-
+    setBlockChangeSlotFree(i, false);
+    linkBlockChange(i);
     #ifdef ALLOW_CHESTS
-      if (block == B_chest) i += 14;
+      if (block == B_chest) {
+        for (int j = 1; j < 15 && i + j < MAX_BLOCK_CHANGES; j ++) setBlockChangeSlotFree(i + j, false);
+        i += 14;
+      }
     #endif
   }
 
   block_change_index_dirty = false;
+
 }
 
 static void ensureBlockChangeIndex () {
@@ -326,6 +379,8 @@ static void ensureBlockChangeIndex () {
   rebuildBlockChangeIndex();
 }
 
+// Marks the indexes of block_changes as stale, after it has been
+// overwritten in bulk. They are rebuilt on next use.
 void invalidateBlockChangeIndex () {
   block_change_index_dirty = true;
 }
@@ -340,19 +395,69 @@ int nextIndexedBlockChange (int index) {
   return block_change_next[index];
 }
 
-int findBlockChangeIndex (short x, uint8_t y, short z) {
-  short chunk_x = div_floor(x, 16);
-  short chunk_z = div_floor(z, 16);
+// Returns the first free slot of block_changes, or -1 if there is none.
+static int findFreeBlockChangeSlot () {
+  for (int i = 0; i < (BLOCK_CHANGE_FREE_WORDS + 63) / 64; i ++) {
+    if (block_change_free_words[i] == 0) continue;
+    int word = i * 64 + __builtin_ctzll(block_change_free_words[i]);
+    return word * 64 + __builtin_ctzll(block_change_free[word]);
+  }
+  return -1;
+}
+
+#ifdef ALLOW_CHESTS
+// Returns the first slot of the first run of `length` free slots of
+// block_changes, or -1 if there is none. `length` must be below 64.
+static int findFreeBlockChangeRun (int length) {
+  // Free slots at the top of the words before
+  int run = 0;
+  for (int i = 0; i < BLOCK_CHANGE_FREE_WORDS; i ++) {
+    uint64_t bits = block_change_free[i];
+    if (bits == ~0ull) {
+      run += 64;
+      if (run >= length) return i * 64 + 64 - run;
+      continue;
+    }
+    // A run carried over from the words before
+    if (run + __builtin_ctzll(~bits) >= length) return i * 64 - run;
+    // A run within this word: bit j of `starts` is set if slots
+    // j to j + length - 1 are all free
+    uint64_t starts = bits;
+    for (int j = 1; j < length && starts; j ++) starts &= bits >> j;
+    if (starts) return i * 64 + __builtin_ctzll(starts);
+    run = __builtin_clzll(~bits);
+  }
+  return -1;
+}
+#endif
 
-  for (int i = firstBlockChangeInChunk(chunk_x, chunk_z); i != -1; i = nextIndexedBlockChange(i)) {
+// Returns the index of the block change at (x, y, z), or -1 if none.
+int findBlockChangeIndex (short x, uint8_t y, short z) {
+  ensureBlockChangeIndex();
+  int i = block_change_coord_heads[getBlockChangeCoordBucket(x, y, z)];
+  for (; i != -1; i = block_change_coord_next[i]) {
     if (block_changes[i].x == x && block_changes[i].y == y && block_changes[i].z == z) {
       return i;
     }
   }
-
   return -1;
 }
 
+// Checks whether any block change affects the encoded chunk at (x, z).
+// Neighbors count too, since their emitters light this chunk.
+uint8_t hasBlockChangesNear (short x, short z) {
+  for (short chunk_x = x - 1; chunk_x <= x + 1; chunk_x ++) {
+    for (short chunk_z = z - 1; chunk_z <= z + 1; chunk_z ++) {
+      for (int i = firstBlockChangeInChunk(chunk_x, chunk_z); i != -1; i = nextIndexedBlockChange(i)) {
+        if (div_floor(block_changes[i].x, 16) != chunk_x) continue;
+        if (div_floor(block_changes[i].z, 16) != chunk_z) continue;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 void setClientState (int client_fd, int new_state) {
   // Look for a client state with a matching file descriptor
   for (int i = 0; i < MAX_PLAYERS * 2; i += 2) {
@@ -418,11 +523,6 @@ int reservePlayerData (int client_fd, uint8_t *uuid, char *name) {
       // Flag player as loading
       player_data[i].flags |= 0x20;
       player_data[i].flagval_16 = 0;
-      // Reset their recently visited chunk list
-      for (int j = 0; j < VISITED_HISTORY; j ++) {
-        player_data[i].visited_x[j] = 32767;
-        player_data[i].visited_z[j] = 32767;
-      }
       return 0;
     }
     // Search for unallocated player slots
@@ -484,6 +584,7 @@ void handlePlayerDisconnect (int client_fd) {
     if (player_data[i].client_fd != client_fd) continue;
     // Mark the player as being offline
     player_data[i].client_fd = -1;
+    clearChunkView(&player_data[i]);
     // Prepare leave message for broadcast
     uint8_t player_name_len = strlen(player_data[i].name);
     strcpy((char *)recv_buffer, player_data[i].name);
@@ -782,15 +883,12 @@ void spawnPlayer (PlayerData *player) {
 
   task_yield(); // Yield between packet bursts.
 
-  // Send spawn chunk first
-  sc_chunkDataAndUpdateLight(player->client_fd, _x, _z);
-  for (int i = -view_distance; i <= view_distance; i ++) {
-    for (int j = -view_distance; j <= view_distance; j ++) {
-      if (i == 0 && j == 0) continue;
-      sc_chunkDataAndUpdateLight(player->client_fd, _x + i, _z + j);
-    }
-  }
-  // Re-teleport player after all chunks have been sent
+  // Queue the view and send the spawn chunk right away, even if a worker
+  // has yet to generate it. The rest is streamed by drainChunkQueues as
+  // the client acknowledges.
+  startChunkView(player, _x, _z);
+  sendChunkNow(player, _x, _z);
+  // Re-teleport player now that the spawn chunk has been sent
   sc_synchronizePlayerPosition(player->client_fd, spawn_x, spawn_y, spawn_z, spawn_yaw, spawn_pitch);
 
   task_yield(); // Yield between packet bursts.
@@ -860,6 +958,7 @@ void broadcastMobMetadata (int client_fd, int entity_id) {
   if (client_fd == -1) {
     FOR_EACH_VISIBLE_PLAYER(i) {
       PlayerData* player = &player_data[i];
+      if (!isMobTracked(player, mob_index)) continue;
       client_fd = player->client_fd;
 
       sc_setEntityMetadata(client_fd, entity_id, metadata, length);
@@ -891,12 +990,30 @@ void failBlockChange (short x, uint8_t y, short z, uint8_t block) {
 
 }
 
-uint8_t makeBlockChange (short x, uint8_t y, short z, uint8_t block) {
-
-  // Transmit block update to all in-game clients
-  FOR_EACH_VISIBLE_PLAYER(i) {
-    sc_blockUpdate(player_data[i].client_fd, x, y, z, block);
+#ifdef OCCLUDE_HIDDEN_BLOCKS
+// Sends the true blocks around (x, y, z) once an occluding block there
+// is replaced by one that is not, as chunks may have hidden them.
+static void revealOccludedBlocks (short x, uint8_t y, short z, uint8_t before, uint8_t after) {
+  if (!isOccludingBlock(before) || isOccludingBlock(after)) return;
+  static const int8_t offsets[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+  };
+  for (int i = 0; i < 6; i ++) {
+    int ny = y + offsets[i][1];
+    if (ny < 0 || ny > 255) continue;
+    short nx = x + offsets[i][0], nz = z + offsets[i][2];
+    uint8_t block = getBlockAt(nx, ny, nz);
+    if (!isOccludingBlock(block)) continue;
+    FOR_EACH_VISIBLE_PLAYER(j) {
+      sc_blockUpdate(player_data[j].client_fd, nx, ny, nz, block);
+    }
   }
+}
+#endif
+
+// Records `block` at the given coordinates in block_changes.
+// Returns 0 on success, or 1 if block_changes is out of space.
+static uint8_t storeBlockChange (short x, uint8_t y, short z, uint8_t block) {
 
   // Calculate terrain at these coordinates and compare it to the input block.
   // Since block changes get overlayed on top of terrain, we don't want to
@@ -913,51 +1030,39 @@ uint8_t makeBlockChange (short x, uint8_t y, short z, uint8_t block) {
   uint8_t is_base_block = block == getTerrainAt(x, y, z, anchor);
 
   // In the block_changes array, 0xFF indicates a missing/restored entry.
-  // We track the position of the first such "gap" for when the operation
-  // Isn't replacing an existing block change.
-  int first_gap = block_changes_count;
+  // Free slots and the entries at each set of coordinates and in each
+  // chunk are indexed, see rebuildBlockChangeIndex.
+  ensureBlockChangeIndex();
 
   // Prioritize replacing entries with matching coordinates
   // This prevents having conflicting entries for one set of coordinates
-  for (int i = 0; i < block_changes_count; i ++) {
-    if (block_changes[i].block == 0xFF) {
-      if (first_gap == block_changes_count) first_gap = i;
-      continue;
-    }
-    if (
-      block_changes[i].x == x &&
-      block_changes[i].y == y &&
-      block_changes[i].z == z
-    ) {
-      #ifdef ALLOW_CHESTS
-      // When replacing chests, clear following 14 entries too (item data)
-      if (block_changes[i].block == B_chest) {
-        for (int j = 1; j < 15; j ++) block_changes[i + j].block = 0xFF;
-      }
-      #endif
-      if (is_base_block) block_changes[i].block = 0xFF;
-      else {
-        #ifdef ALLOW_CHESTS
-        // When placing chests, just unallocate the target block and fall
-        // Through to the chest-specific routine below.
-        if (block == B_chest) {
-          block_changes[i].block = 0xFF;
-          if (first_gap > i) first_gap = i;
-          #ifndef DISK_SYNC_BLOCKS_ON_INTERVAL
-          writeBlockChangesToDisk(i, i);
-          #endif
-          invalidateBlockChangeIndex();
-          break;
-        }
-        #endif
-        block_changes[i].block = block;
+  int i = findBlockChangeIndex(x, y, z);
+  if (i != -1) {
+    #ifdef ALLOW_CHESTS
+    // When replacing chests, clear following 14 entries too (item data)
+    if (block_changes[i].block == B_chest) {
+      for (int j = 1; j < 15; j ++) {
+        block_changes[i + j].block = 0xFF;
+        setBlockChangeSlotFree(i + j, true);
       }
-      #ifndef DISK_SYNC_BLOCKS_ON_INTERVAL
-      writeBlockChangesToDisk(i, i);
-      #endif
-      invalidateBlockChangeIndex();
-      return 0;
     }
+    // When placing chests, just unallocate the target block and fall
+    // Through to the chest-specific routine below.
+    uint8_t placing_chest = !is_base_block && block == B_chest;
+    #else
+    uint8_t placing_chest = false;
+    #endif
+    if (is_base_block || placing_chest) {
+      unlinkBlockChange(i);
+      block_changes[i].block = 0xFF;
+      setBlockChangeSlotFree(i, true);
+    } else {
+      block_changes[i].block = block;
+    }
+    #ifndef DISK_SYNC_BLOCKS_ON_INTERVAL
+    writeBlockChangesToDisk(i, i);
+    #endif
+    if (!placing_chest) return 0;
   }
 
   // Don't create a new entry if it contains the base terrain block
@@ -967,68 +1072,85 @@ uint8_t makeBlockChange (short x, uint8_t y, short z, uint8_t block) {
   if (block == B_chest) {
     // Chests require 15 entries total, so for maximum space-efficiency,
     // We have to find a continuous gap that's at least 15 slots wide.
-    // By design, this loop also continues past the current search range,
-    // Which naturally appends the chest to the end if a gap isn't found.
-    int last_real_entry = first_gap - 1;
-    for (int i = first_gap; i <= block_changes_count + 15; i ++) {
-      if (i >= MAX_BLOCK_CHANGES) break; // No more space, trigger failBlockChange
-
-      if (block_changes[i].block != 0xFF) {
-        last_real_entry = i;
-        continue;
-      }
-      if (i - last_real_entry != 15) continue;
-      // A wide enough gap has been found, assign the chest
-      block_changes[last_real_entry + 1].x = x;
-      block_changes[last_real_entry + 1].y = y;
-      block_changes[last_real_entry + 1].z = z;
-      block_changes[last_real_entry + 1].block = block;
-      // Zero out the following 14 entries for item data
-      for (int i = 2; i <= 15; i ++) {
-        block_changes[last_real_entry + i].x = 0;
-        block_changes[last_real_entry + i].y = 0;
-        block_changes[last_real_entry + i].z = 0;
-        block_changes[last_real_entry + i].block = 0;
-      }
-      // Extend future search range if necessary
-      if (i >= block_changes_count) {
-        block_changes_count = i + 1;
-      }
-      // Write changes to disk (if applicable)
-      #ifndef DISK_SYNC_BLOCKS_ON_INTERVAL
-      writeBlockChangesToDisk(last_real_entry + 1, last_real_entry + 15);
-      #endif
-      invalidateBlockChangeIndex();
-      return 0;
+    // Gaps include all slots past the end of the search range, which
+    // naturally appends the chest to the end if no earlier gap fits.
+    i = findFreeBlockChangeRun(15);
+    if (i == -1) {
+      // If we're here, no changes were made
+      failBlockChange(x, y, z, block);
+      return 1;
     }
-    // If we're here, no changes were made
-    failBlockChange(x, y, z, block);
-    return 1;
+    block_changes[i].x = x;
+    block_changes[i].y = y;
+    block_changes[i].z = z;
+    block_changes[i].block = block;
+    setBlockChangeSlotFree(i, false);
+    linkBlockChange(i);
+    // Zero out the following 14 entries for item data
+    for (int j = 1; j < 15; j ++) {
+      block_changes[i + j].x = 0;
+      block_changes[i + j].y = 0;
+      block_changes[i + j].z = 0;
+      block_changes[i + j].block = 0;
+      setBlockChangeSlotFree(i + j, false);
+    }
+    // Extend future search range if necessary
+    if (i + 15 > block_changes_count) {
+      block_changes_count = i + 15;
+    }
+    // Write changes to disk (if applicable)
+    #ifndef DISK_SYNC_BLOCKS_ON_INTERVAL
+    writeBlockChangesToDisk(i, i + 14);
+    #endif
+    return 0;
   }
   #endif
 
   // Handles exhaustion of block_change capacity.
-  if (first_gap == MAX_BLOCK_CHANGES) {
+  i = findFreeBlockChangeSlot();
+  if (i == -1) {
     failBlockChange(x, y, z, block);
     return 1;
   }
 
-  // Fall back to storing the change at the first possible gap
-  block_changes[first_gap].x = x;
-  block_changes[first_gap].y = y;
-  block_changes[first_gap].z = z;
-  block_changes[first_gap].block = block;
+  // Store the change at the first possible gap
+  block_changes[i].x = x;
+  block_changes[i].y = y;
+  block_changes[i].z = z;
+  block_changes[i].block = block;
+  setBlockChangeSlotFree(i, false);
+  linkBlockChange(i);
   // Write change to disk (if applicable)
   #ifndef DISK_SYNC_BLOCKS_ON_INTERVAL
-  writeBlockChangesToDisk(first_gap, first_gap);
+  writeBlockChangesToDisk(i, i);
   #endif
   // Extend future search range if we've appended to the end
-  if (first_gap == block_changes_count) {
-    block_changes_count ++;
+  if (i >= block_changes_count) {
+    block_changes_count = i + 1;
+  }
+
+  return 0;
+}
+
+uint8_t makeBlockChange (short x, uint8_t y, short z, uint8_t block) {
+
+  // Transmit block update to all in-game clients
+  FOR_EACH_VISIBLE_PLAYER(i) {
+    sc_blockUpdate(player_data[i].client_fd, x, y, z, block);
   }
 
-  invalidateBlockChangeIndex();
+  #ifdef OCCLUDE_HIDDEN_BLOCKS
+  revealOccludedBlocks(x, y, z, getBlockAt(x, y, z), block);
+  #endif
+
+  // Any change can move an emitter or an occluder
+  invalidateBlockLightAt(x, y, z);
+
+  if (storeBlockChange(x, y, z, block)) return 1;
+  updateBlockCache(x, y, z, block);
+  updateChunkSummary(x, y, z, block);
   return 0;
+
 }
 
 // Returns the result of mining a block, taking into account the block type and tools
@@ -1491,6 +1613,87 @@ void handleFluidMovement (short x, uint8_t y, short z, uint8_t fluid, uint8_t bl
 
 }
 
+#define DEFERRED_FLUID_BUCKETS 512
+
+// Fluids that were updated outside of simulation distance, left at rest
+// until their chunk is simulated again. Not persisted. Entries are chained
+// by coordinate bucket, so that deferring an update already queued is cheap.
+static struct {
+  short x;
+  uint8_t y;
+  short z;
+} deferred_fluid_updates[MAX_DEFERRED_FLUID_UPDATES];
+static int deferred_fluid_update_count = 0;
+static int16_t deferred_fluid_heads[DEFERRED_FLUID_BUCKETS];
+static int16_t deferred_fluid_next[MAX_DEFERRED_FLUID_UPDATES];
+static uint8_t deferred_fluid_heads_ready = false;
+// Set while the queue is full, so that overflow is reported once
+static uint8_t deferred_fluid_overflowed = false;
+
+static int16_t *getDeferredFluidHead (short x, uint8_t y, short z) {
+  if (!deferred_fluid_heads_ready) {
+    for (int i = 0; i < DEFERRED_FLUID_BUCKETS; i ++) deferred_fluid_heads[i] = -1;
+    deferred_fluid_heads_ready = true;
+  }
+  return &deferred_fluid_heads[getBlockChangeCoordBucket(x, y, z) & (DEFERRED_FLUID_BUCKETS - 1)];
+}
+
+// Takes the entry at `index` out of its coordinate chain
+static void unlinkDeferredFluidUpdate (int index) {
+  int16_t *link = getDeferredFluidHead(
+    deferred_fluid_updates[index].x,
+    deferred_fluid_updates[index].y,
+    deferred_fluid_updates[index].z
+  );
+  while (*link != -1 && *link != index) link = &deferred_fluid_next[*link];
+  if (*link == index) *link = deferred_fluid_next[index];
+}
+
+// Queues the fluid at (x, y, z) for replayDeferredFluidUpdates. Returns
+// false if the queue is full, in which case the caller flows it now.
+static uint8_t deferFluidUpdate (short x, uint8_t y, short z) {
+  int16_t *head = getDeferredFluidHead(x, y, z);
+  for (int i = *head; i != -1; i = deferred_fluid_next[i]) {
+    if (
+      deferred_fluid_updates[i].x == x &&
+      deferred_fluid_updates[i].y == y &&
+      deferred_fluid_updates[i].z == z
+    ) return true;
+  }
+  if (deferred_fluid_update_count >= MAX_DEFERRED_FLUID_UPDATES) {
+    if (!deferred_fluid_overflowed) {
+      printf("Deferred fluid queue full, flowing fluids outside simulation distance\n");
+      deferred_fluid_overflowed = true;
+    }
+    return false;
+  }
+  int index = deferred_fluid_update_count ++;
+  deferred_fluid_updates[index].x = x;
+  deferred_fluid_updates[index].y = y;
+  deferred_fluid_updates[index].z = z;
+  deferred_fluid_next[index] = *head;
+  *head = index;
+  return true;
+}
+
+// Removes the entry at `index`, moving the last entry into its place
+static void removeDeferredFluidUpdate (int index) {
+  int last = -- deferred_fluid_update_count;
+  unlinkDeferredFluidUpdate(index);
+  if (index != last) {
+    unlinkDeferredFluidUpdate(last);
+    deferred_fluid_updates[index] = deferred_fluid_updates[last];
+    int16_t *head = getDeferredFluidHead(
+      deferred_fluid_updates[index].x,
+      deferred_fluid_updates[index].y,
+      deferred_fluid_updates[index].z
+    );
+    deferred_fluid_next[index] = *head;
+    *head = index;
+  }
+  deferred_fluid_overflowed = false;
+}
+
 void checkFluidUpdate (short x, uint8_t y, short z, uint8_t block) {
 
   uint8_t fluid;
@@ -1498,10 +1701,35 @@ void checkFluidUpdate (short x, uint8_t y, short z, uint8_t block) {
   else if (block >= B_lava && block < B_lava + 4) fluid = B_lava;
   else return;
 
+  // Hold fluids outside of simulation distance back until it reaches them.
+  // If too many are held back already, this one flows right away instead.
+  if (
+    !isChunkSimulated(div_floor(x, 16), div_floor(z, 16)) &&
+    deferFluidUpdate(x, y, z)
+  ) return;
+
   handleFluidMovement(x, y, z, fluid, block);
 
 }
 
+// Updates the deferred fluids whose chunks have entered simulation
+// distance, against the blocks that are there now
+static void replayDeferredFluidUpdates () {
+  int i = 0;
+  while (i < deferred_fluid_update_count) {
+    short x = deferred_fluid_updates[i].x;
+    uint8_t y = deferred_fluid_updates[i].y;
+    short z = deferred_fluid_updates[i].z;
+    if (!isChunkSimulated(div_floor(x, 16), div_floor(z, 16))) {
+      i ++;
+      continue;
+    }
+    // Remove the entry first, as the update may defer others
+    removeDeferredFluidUpdate(i);
+    checkFluidUpdate(x, y, z, getBlockAt(x, y, z));
+  }
+}
+
 #ifdef ENABLE_PICKUP_ANIMATION
 // Plays the item pickup animation with the given item at the given coordinates
 void playPickupAnimation (PlayerData *player, uint16_t item, double x, double y, double z) {
@@ -1768,6 +1996,59 @@ void handlePlayerUseItem (PlayerData *player, short x, short y, short z, uint8_t
 
 }
 
+// Sends the entity of mob `mob_index` to a player and starts tracking it.
+static void sendMobEntity (PlayerData *player, int mob_index, uint8_t yaw) {
+  // Forge a UUID from a random number and the mob's index
+  uint8_t uuid[16];
+  uint32_t r = fast_rand();
+  memcpy(uuid, &r, 4);
+  memcpy(uuid + 4, &mob_index, 4);
+  memset(uuid + 8, 0, 8);
+
+  MobData *mob = &mob_data[mob_index];
+  sc_spawnEntity(
+    player->client_fd,
+    -2 - mob_index, // Use negative IDs to avoid conflicts with player IDs
+    uuid, mob->type, (double)mob->x + 0.5f, mob->y, (double)mob->z + 0.5f,
+    yaw, 0
+  );
+  broadcastMobMetadata(player->client_fd, -2 - mob_index);
+  setMobTracked(player, mob_index, true);
+}
+
+// Removes the entity of mob `mob_index` from every player tracking it.
+static void untrackMob (int mob_index) {
+  for (int j = 0; j < MAX_PLAYERS; j ++) {
+    if (!isMobTracked(&player_data[j], mob_index)) continue;
+    if (player_data[j].client_fd != -1) sc_removeEntity(player_data[j].client_fd, -2 - mob_index);
+    setMobTracked(&player_data[j], mob_index, false);
+  }
+}
+
+/**
+ * Sends mobs that came into a player's view distance and removes those
+ * that left it, so that clients only track mobs in chunks they hold.
+ */
+static void updateMobTracking () {
+  for (int i = 0; i < MAX_MOBS; i ++) {
+    if (mob_data[i].type == 0) continue;
+    if ((mob_data[i].data & 31) == 0) continue;
+    short chunk_x = div_floor(mob_data[i].x, 16);
+    short chunk_z = div_floor(mob_data[i].z, 16);
+    for (int j = 0; j < MAX_PLAYERS; j ++) {
+      PlayerData *player = &player_data[j];
+      if (player->client_fd == -1) continue;
+      uint8_t in_view = isChunkInView(player, chunk_x, chunk_z);
+      uint8_t tracked = isMobTracked(player, i);
+      if (in_view && !tracked) sendMobEntity(player, i, 0);
+      else if (!in_view && tracked) {
+        sc_removeEntity(player->client_fd, -2 - i);
+        setMobTracked(player, i, false);
+      }
+    }
+  }
+}
+
 void spawnMob (uint8_t type, short x, uint8_t y, short z, uint8_t health) {
 
   for (int i = 0; i < MAX_MOBS; i ++) {
@@ -1788,24 +2069,13 @@ void spawnMob (uint8_t type, short x, uint8_t y, short z, uint8_t health) {
       villager_job[i] = fast_rand() % 3;
     }
 
-    // Forge a UUID from a random number and the mob's index
-    uint8_t uuid[16];
-    uint32_t r = fast_rand();
-    memcpy(uuid, &r, 4);
-    memcpy(uuid + 4, &i, 4);
-
-    // Broadcast entity creation to all players
+    // Send entity creation to players who have the mob's chunk loaded
     for (int j = 0; j < MAX_PLAYERS; j ++) {
       if (player_data[j].client_fd == -1) continue;
       if (player_data[j].flags & 0x20) continue;
-      sc_spawnEntity(
-        player_data[j].client_fd,
-        -2 - i, // Use negative IDs to avoid conflicts with player IDs
-        uuid, // Use the UUID generated above
-        type, (double)x + 0.5f, y, (double)z + 0.5f,
-        // Face opposite of the player, as if looking at them when spawning
-        (player_data[j].yaw + 127) & 255, 0
-      );
+      if (!isChunkInView(&player_data[j], div_floor(x, 16), div_floor(z, 16))) continue;
+      // Face opposite of the player, as if looking at them when spawning
+      sendMobEntity(&player_data[j], i, (player_data[j].yaw + 127) & 255);
     }
 
     // Freshly spawned mobs currently don't need metadata updates.
@@ -1842,11 +2112,6 @@ void movePlayerToNetherZone (PlayerData *player, uint8_t to_nether) {
   player->y = getHeightAt(player->x, player->z) + 1;
   player->grounded_y = player->y;
 
-  for (int i = 0; i < VISITED_HISTORY; i ++) {
-    player->visited_x[i] = 32767;
-    player->visited_z[i] = 32767;
-  }
-
   if (to_nether) sc_systemChat(player->client_fd, "Entered the nether zone", 23);
   else sc_systemChat(player->client_fd, "Returned to overworld", 21);
 
@@ -2146,10 +2411,11 @@ void hurtEntity (int entity_id, int attacker_id, uint8_t damage_type, uint8_t da
 
   }
 
-  // Broadcast damage event to all players
+  // Broadcast damage event to all players that can see the entity
   for (int i = 0; i < MAX_PLAYERS; i ++) {
     int client_fd = player_data[i].client_fd;
     if (client_fd == -1) continue;
+    if (entity_id < 0 && !isMobTracked(&player_data[i], -entity_id - 2)) continue;
     if (mob_hurt_event) {
       sc_entityEvent(client_fd, entity_id, 2);
       if (!entity_died && mob_sound_hurt != -1) {
@@ -2255,6 +2521,9 @@ void handleServerTick (int64_t time_since_last_tick) {
   // Perform regular checks for if it's time to write to disk
   writeDataToDiskOnInterval();
 
+  // Let fluids flow that players have come close enough to
+  replayDeferredFluidUpdates();
+
   /**
    * If the RNG seed ever hits 0, it'll never generate anything
    * else. This is because the fast_rand function uses a simple
@@ -2281,11 +2550,12 @@ void handleServerTick (int64_t time_since_last_tick) {
       villager_xp[i] = 0;
       for (int j = 0; j < MAX_PLAYERS; j ++) {
         if (player_data[j].client_fd == -1) continue;
+        if (!isMobTracked(&player_data[j], i)) continue;
         // Spawn death smoke particles
         sc_entityEvent(player_data[j].client_fd, entity_id, 60);
-        // Remove the entity from the client
-        sc_removeEntity(player_data[j].client_fd, entity_id);
       }
+      // Remove the entity from the clients
+      untrackMob(i);
       continue;
     }
 
@@ -2300,8 +2570,11 @@ void handleServerTick (int64_t time_since_last_tick) {
     // Currently has no effect on hostile mobs
     uint8_t panic = (mob_data[i].data >> 6) & 3;
 
+    // Mobs outside every player's simulation distance only despawn
+    uint8_t simulated = isChunkSimulated(div_floor(mob_data[i].x, 16), div_floor(mob_data[i].z, 16));
+
     // Burn hostile mobs if above ground during sunlight
-    if (!passive && (world_time < 13000 || world_time > 23460) && mob_data[i].y > 48) {
+    if (simulated && !passive && (world_time < 13000 || world_time > 23460) && mob_data[i].y > 48) {
       hurtEntity(entity_id, -1, D_on_fire, 2);
     }
 
@@ -2349,8 +2622,10 @@ void handleServerTick (int64_t time_since_last_tick) {
       villager_job[i] = 0;
       villager_level[i] = 0;
       villager_xp[i] = 0;
+      untrackMob(i);
       continue;
     }
+    if (!simulated) continue;
 
     short old_x = mob_data[i].x, old_z = mob_data[i].z;
     uint8_t old_y = mob_data[i].y;
@@ -2482,6 +2757,7 @@ void handleServerTick (int64_t time_since_last_tick) {
     // Broadcast relevant entity movement packets
     for (int j = 0; j < MAX_PLAYERS; j ++) {
       if (player_data[j].client_fd == -1) continue;
+      if (!isMobTracked(&player_data[j], i)) continue;
       sc_moveEntityPosRot (
         player_data[j].client_fd, entity_id,
         (double)old_x + 0.5, (double)old_y, (double)old_z + 0.5,
@@ -2493,6 +2769,9 @@ void handleServerTick (int64_t time_since_last_tick) {
 
   }
 
+  // Follow mobs across view distance boundaries
+  updateMobTracking();
+
 }
 
 #ifdef ALLOW_CHESTS
@@ -17,6 +17,8 @@
 #include "registries.h"
 #include "serialize.h"
 #include "procedures.h"
+#include "worldgen.h"
+#include "light.h"
 
 int64_t last_disk_sync_time = 0;
 
@@ -143,6 +145,9 @@ int initSerializer () {
       if (i >= block_changes_count) block_changes_count = i + 1;
     }
     invalidateBlockChangeIndex();
+    clearBlockCache();
+    clearChunkSummaries();
+    clearBlockLightCache();
     // Seek to persisted player section.
     if (fseek(file, sizeof(block_changes), SEEK_SET) != 0) {
       perror("Failed to seek to player data in \"world.bin\". Aborting.");
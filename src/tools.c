@@ -14,6 +14,10 @@
     #include <sys/socket.h>
     #include <arpa/inet.h>
   #endif
+  #ifdef __linux__
+    #include <sys/ioctl.h>
+    #include <linux/sockios.h>
+  #endif
   #include <unistd.h>
   #include <time.h>
   #ifndef CLOCK_MONOTONIC
@@ -263,6 +267,19 @@ void flush_all_send_buffers () {
   }
 }
 
+// Returns the bytes written to `client_fd` that have not left this host
+// yet: those still buffered here, plus the kernel send queue on Linux.
+size_t getPendingSendBytes (int client_fd) {
+  size_t pending = 0;
+  int slot = findSendBufferSlot(client_fd, false);
+  if (slot != -1) pending += send_buffers[slot].len;
+  #ifdef __linux__
+    int queued = 0;
+    if (ioctl(client_fd, SIOCOUTQ, &queued) == 0 && queued > 0) pending += (size_t)queued;
+  #endif
+  return pending;
+}
+
 uint8_t readByte (int client_fd) {
   recv_count = recv_all(client_fd, recv_buffer, 1, false);
   return recv_buffer[0];
@@ -0,0 +1,247 @@
+#include "globals.h"
+
+#ifdef WORLDGEN_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tools.h"
+#include "registries.h"
+#include "procedures.h"
+#include "worldgen.h"
+#include "worldbench.h"
+
+#define GOLDEN_FILE_PATH "assets/worldgen_golden.txt"
+// Raw seed of every benchmark run, whatever world.meta holds
+#define BENCH_WORLD_SEED INITIAL_WORLD_SEED
+// North-west corner of the square of chunks generated, in chunks
+#define BENCH_ORIGIN_X -8
+#define BENCH_ORIGIN_Z -8
+// Block changes laid over each chunk, so that the overlay stage has work
+#define BENCH_CHANGES_PER_CHUNK 8
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+static const char *stage_names[WORLDGEN_STAGE_COUNT] = {
+  "anchors", "heights", "terrain", "changes"
+};
+
+static int64_t getBenchTime () {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// FNV-1a hash of the name of each block ID, see hashSectionBlocks
+static uint64_t block_name_hashes[256];
+
+static void hashBlockNames () {
+  for (size_t i = 0; i < sizeof(block_names) / sizeof(block_names[0]); i ++) {
+    uint64_t hash = FNV_OFFSET;
+    for (const char *c = block_names[i]; *c; c ++) hash = (hash ^ (uint8_t)*c) * FNV_PRIME;
+    block_name_hashes[i] = hash;
+  }
+}
+
+// Folds the blocks of a section into a hash. Blocks are hashed by name,
+// which unlike B_* IDs and protocol state IDs does not depend on the
+// registries the server was built with.
+static uint64_t hashSectionBlocks (uint64_t hash, const uint8_t *blocks) {
+  for (int i = 0; i < 4096; i ++) {
+    hash = (hash ^ block_name_hashes[blocks[i]]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+// Lays a fixed pattern of dug out and placed blocks over each chunk,
+// the way world.bin would be loaded
+static void addBenchBlockChanges (int chunk_count, int side) {
+  for (int i = 0; i < chunk_count; i ++) {
+    int chunk_x = BENCH_ORIGIN_X + i % side;
+    int chunk_z = BENCH_ORIGIN_Z + i / side;
+    for (int j = 0; j < BENCH_CHANGES_PER_CHUNK; j ++) {
+      if (block_changes_count >= MAX_BLOCK_CHANGES) break;
+      uint64_t h = splitmix64((uint64_t)i * BENCH_CHANGES_PER_CHUNK + j);
+      BlockChange *change = &block_changes[block_changes_count ++];
+      change->x = chunk_x * 16 + (h & 15);
+      change->z = chunk_z * 16 + (h >> 4 & 15);
+      change->y = 32 + (h >> 8) % 64;
+      change->block = j & 1 ? B_stone : B_air;
+    }
+  }
+  invalidateBlockChangeIndex();
+}
+
+static int compareTimes (const void *a, const void *b) {
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Returns the `percent`-th percentile of `times`, which gets sorted
+static int64_t getPercentile (int64_t *times, int count, int percent) {
+  qsort(times, (size_t)count, sizeof(int64_t), compareTimes);
+  return times[(int64_t)(count - 1) * percent / 100];
+}
+
+// Looks up the golden hash recorded under `key`.
+// Returns 0 if found, 1 if there is none.
+static int readGoldenHash (const char *key, uint64_t *hash) {
+  FILE *file = fopen(GOLDEN_FILE_PATH, "r");
+  if (!file) return 1;
+  char line[256];
+  size_t key_length = strlen(key);
+  int result = 1;
+  while (fgets(line, sizeof(line), file)) {
+    if (strncmp(line, key, key_length) != 0 || line[key_length] != ' ') continue;
+    unsigned long long value;
+    if (sscanf(line + key_length, "%llx", &value) != 1) continue;
+    *hash = value;
+    result = 0;
+  }
+  fclose(file);
+  return result;
+}
+
+// Records `hash` under `key`, replacing any earlier entry.
+// Returns 0 on success.
+static int writeGoldenHash (const char *key, uint64_t hash) {
+  FILE *file = fopen(GOLDEN_FILE_PATH, "r");
+  FILE *out = fopen(GOLDEN_FILE_PATH ".tmp", "w");
+  if (!out) {
+    perror("Failed to open golden hashes for writing");
+    if (file) fclose(file);
+    return 1;
+  }
+  char line[256];
+  size_t key_length = strlen(key);
+  while (file && fgets(line, sizeof(line), file)) {
+    if (strncmp(line, key, key_length) == 0 && line[key_length] == ' ') continue;
+    fputs(line, out);
+  }
+  if (file) fclose(file);
+  fprintf(out, "%s %016llX\n", key, (unsigned long long)hash);
+  if (fclose(out) != 0 || rename(GOLDEN_FILE_PATH ".tmp", GOLDEN_FILE_PATH) != 0) {
+    remove(GOLDEN_FILE_PATH ".tmp");
+    printf("Failed to write \"%s\"\n", GOLDEN_FILE_PATH);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Generates `chunk_count` chunks of the benchmark seed, in a square
+ * starting at chunk (BENCH_ORIGIN_X, BENCH_ORIGIN_Z), the way chunks are
+ * built for sending. Prints throughput and per-chunk percentiles of each
+ * stage, then checks the hash of all sections against GOLDEN_FILE_PATH,
+ * or records it there if `record` is set.
+ * Must run before block changes are loaded.
+ * Returns 0 if the hash matches the recorded one or has been recorded.
+ */
+int runWorldgenBench (int chunk_count, uint8_t record) {
+
+  if (chunk_count < 1) chunk_count = 1;
+  int side = 1;
+  while (side * side < chunk_count) side ++;
+
+  world_seed = splitmix64(BENCH_WORLD_SEED);
+  hashBlockNames();
+  addBenchBlockChanges(chunk_count, side);
+
+  // Per chunk: time of each stage, then the total
+  int64_t *times = malloc(sizeof(int64_t) * (WORLDGEN_STAGE_COUNT + 1) * chunk_count);
+  if (times == NULL) return 1;
+
+  #ifdef WORLDGEN_FIXED_NOISE
+    const char *noise = "fixed";
+  #else
+    const char *noise = "float";
+  #endif
+  printf(
+    "Bench: %d chunks from (%d, %d), seed %08X, generator v%u (%s noise)\n",
+    chunk_count, BENCH_ORIGIN_X, BENCH_ORIGIN_Z, world_seed, WORLDGEN_VERSION, noise
+  );
+
+  // Same sections as buildChunkPacketBody: minY=-64, height=384
+  const int section_count = 24;
+  const int section_base_y = -64;
+  WorldgenContext *context = getWorldgenContext();
+  uint64_t hash = FNV_OFFSET;
+  int64_t elapsed = 0;
+
+  for (int i = 0; i < chunk_count; i ++) {
+    int x = (BENCH_ORIGIN_X + i % side) * 16;
+    int z = (BENCH_ORIGIN_Z + i / side) * 16;
+    memset(context->stage_time, 0, sizeof(context->stage_time));
+    int64_t chunk_time = 0;
+    for (int j = 0; j < section_count; j ++) {
+      int64_t start = getBenchTime();
+      buildChunkSection(x, section_base_y + j * 16, z);
+      chunk_time += getBenchTime() - start;
+      hash = hashSectionBlocks(hash, context->section);
+    }
+    for (int j = 0; j < WORLDGEN_STAGE_COUNT; j ++) {
+      times[j * chunk_count + i] = context->stage_time[j];
+    }
+    times[WORLDGEN_STAGE_COUNT * chunk_count + i] = chunk_time;
+    elapsed += chunk_time;
+  }
+
+  printf(
+    "Bench: %.1f chunks/s, %.2f ns/block\n",
+    chunk_count * 1e9 / (elapsed > 0 ? elapsed : 1),
+    (double)elapsed / ((double)chunk_count * section_count * 4096)
+  );
+  printf("Bench: %-8s %10s %10s %10s %10s\n", "stage", "total ms", "p50 us", "p90 us", "p99 us");
+  for (int j = 0; j <= WORLDGEN_STAGE_COUNT; j ++) {
+    int64_t *stage_times = times + j * chunk_count;
+    int64_t total = 0;
+    for (int i = 0; i < chunk_count; i ++) total += stage_times[i];
+    printf(
+      "Bench: %-8s %10.2f %10.1f %10.1f %10.1f\n",
+      j < WORLDGEN_STAGE_COUNT ? stage_names[j] : "chunk",
+      total / 1e6,
+      getPercentile(stage_times, chunk_count, 50) / 1e3,
+      getPercentile(stage_times, chunk_count, 90) / 1e3,
+      getPercentile(stage_times, chunk_count, 99) / 1e3
+    );
+  }
+  free(times);
+
+  // Output depends on the generator, its build options, the seed and
+  // the region, so each combination has its own hash
+  char key[128];
+  snprintf(
+    key, sizeof(key), "%04X %d %08X %d",
+    WORLDGEN_VERSION, CHUNK_SIZE, world_seed, chunk_count
+  );
+
+  if (record) {
+    if (writeGoldenHash(key, hash)) return 1;
+    printf("Bench: recorded section hash %016llX in \"%s\"\n", (unsigned long long)hash, GOLDEN_FILE_PATH);
+    return 0;
+  }
+
+  uint64_t golden;
+  if (readGoldenHash(key, &golden)) {
+    printf(
+      "Bench: section hash %016llX, but no golden hash is recorded for \"%s\", run `make worldgen-golden` to record it\n",
+      (unsigned long long)hash, key
+    );
+    return 1;
+  }
+  if (golden != hash) {
+    printf(
+      "Bench: section hash %016llX does not match golden hash %016llX\n",
+      (unsigned long long)hash, (unsigned long long)golden
+    );
+    return 1;
+  }
+  printf("Bench: section hash %016llX matches golden hash\n", (unsigned long long)hash);
+  return 0;
+
+}
+
+#endif
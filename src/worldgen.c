@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "globals.h"
 #include "tools.h"
@@ -14,55 +15,177 @@ static uint8_t isNetherZone (int z) {
   return z >= NETHER_ZONE_OFFSET;
 }
 
-#define BIOME_CACHE_CAPACITY 4096
+#ifdef USE_CHUNK_JOBS
+  #define WORLDGEN_THREAD_LOCAL __thread
+#else
+  #define WORLDGEN_THREAD_LOCAL
+#endif
 
-typedef struct {
-  short x;
-  short z;
-  uint8_t biome;
-  uint8_t used;
-} BiomeCacheEntry;
-
-static BiomeCacheEntry biome_cache[BIOME_CACHE_CAPACITY];
+static WorldgenContext main_worldgen_context;
+static WORLDGEN_THREAD_LOCAL WorldgenContext *worldgen_context = &main_worldgen_context;
 
-static uint32_t hashChunkXZ (short x, short z) {
-  uint32_t ux = (uint16_t)x;
-  uint32_t uz = (uint16_t)z;
-  return (ux * 73856093u) ^ (uz * 19349663u);
+#ifdef WORLDGEN_PROFILE
+  static int64_t getProfileTime () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+  // Starts timing a stage of chunk generation
+  #define PROFILE_BEGIN(start) int64_t start = getProfileTime()
+  // Adds the time since PROFILE_BEGIN to `stage` of the context
+  #define PROFILE_END(context, stage, start) ((context)->stage_time[stage] += getProfileTime() - (start))
+#else
+  #define PROFILE_BEGIN(start)
+  #define PROFILE_END(context, stage, start)
+#endif
+
+// Returns the worldgen context bound to the calling thread.
+WorldgenContext *getWorldgenContext () {
+  return worldgen_context;
 }
 
-static uint8_t getBiomeFromClimateUncached (short x, short z);
+// Binds `context` to the calling thread for all further generation.
+void setWorldgenContext (WorldgenContext *context) {
+  worldgen_context = context;
+}
 
 static float lerp01 (float a, float b, float t) {
   return a + (b - a) * t;
 }
 
+/**
+ * Value noise is built from a few primitives: lattice values, weights of
+ * a position within its lattice cell, and interpolation between values.
+ * With WORLDGEN_FIXED_NOISE these run on integers, values in 1/65536ths
+ * and weights in 1/32768ths, so noise is bit-identical on any platform
+ * and needs no FPU. Either way, noise is returned as a float in [0, 1).
+ */
+#ifdef WORLDGEN_FIXED_NOISE
+
+typedef int32_t NoiseValue;
+typedef int32_t NoiseWeight;
+
+static NoiseValue getLatticeValue (int x, int z, uint64_t salt) {
+  uint64_t key = ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+  uint32_t h = (uint32_t)splitmix64(key ^ salt ^ world_seed);
+  return (NoiseValue)((h >> 8) & 0xFFFF);
+}
+
+// Smoothstep of `offset` / `scale`, for offsets in [0, scale)
+static NoiseWeight getNoiseWeight (int offset, int scale) {
+  uint32_t t = (uint32_t)offset * 32768u / (uint32_t)scale;
+  uint32_t t2 = (t * t) >> 15;
+  return (NoiseWeight)((t2 * (3u * 32768u - 2u * t)) >> 15);
+}
+
+// The product stays within 31 bits, as |b - a| < 2^16 and w < 2^15
+static NoiseValue lerpNoise (NoiseValue a, NoiseValue b, NoiseWeight w) {
+  return a + (((b - a) * w) >> 15);
+}
+
+static float getNoiseFloat (NoiseValue n) {
+  return (float)n * (1.0f / 65536.0f);
+}
+
+#else
+
+typedef float NoiseValue;
+typedef float NoiseWeight;
+
 static float smoothstep01 (float t) {
   return t * t * (3.0f - 2.0f * t);
 }
 
-static float hash01_2d (int x, int z, uint64_t salt) {
+static NoiseValue getLatticeValue (int x, int z, uint64_t salt) {
   uint64_t key = ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
   uint32_t h = (uint32_t)splitmix64(key ^ salt ^ world_seed);
   return (float)(h & 0x00FFFFFFu) / 16777215.0f;
 }
 
+static NoiseWeight getNoiseWeight (int offset, int scale) {
+  return smoothstep01((float)offset / (float)scale);
+}
+
+static NoiseValue lerpNoise (NoiseValue a, NoiseValue b, NoiseWeight w) {
+  return lerp01(a, b, w);
+}
+
+static float getNoiseFloat (NoiseValue n) {
+  return n;
+}
+
+#endif
+
 static float valueNoise2D (int x, int z, int scale, uint64_t salt) {
   int cell_x = div_floor(x, scale);
   int cell_z = div_floor(z, scale);
-  float tx = (float)mod_abs(x, scale) / (float)scale;
-  float tz = (float)mod_abs(z, scale) / (float)scale;
-  tx = smoothstep01(tx);
-  tz = smoothstep01(tz);
+  NoiseWeight tx = getNoiseWeight(mod_abs(x, scale), scale);
+  NoiseWeight tz = getNoiseWeight(mod_abs(z, scale), scale);
 
-  float n00 = hash01_2d(cell_x, cell_z, salt);
-  float n10 = hash01_2d(cell_x + 1, cell_z, salt);
-  float n01 = hash01_2d(cell_x, cell_z + 1, salt);
-  float n11 = hash01_2d(cell_x + 1, cell_z + 1, salt);
+  NoiseValue n00 = getLatticeValue(cell_x, cell_z, salt);
+  NoiseValue n10 = getLatticeValue(cell_x + 1, cell_z, salt);
+  NoiseValue n01 = getLatticeValue(cell_x, cell_z + 1, salt);
+  NoiseValue n11 = getLatticeValue(cell_x + 1, cell_z + 1, salt);
+
+  NoiseValue nx0 = lerpNoise(n00, n10, tx);
+  NoiseValue nx1 = lerpNoise(n01, n11, tx);
+  return getNoiseFloat(lerpNoise(nx0, nx1, tz));
+}
+
+// Widest grid sampleValueNoiseGrid evaluates in one call
+#define NOISE_GRID_MAX 16
+
+/**
+ * Evaluates valueNoise2D over the `width` by `depth` grid of points
+ * `step` apart starting at (x0, z0) and writes it to `out`, along x
+ * first. Adjacent points share lattice corners, so each lattice hash is
+ * computed once per grid rather than four times per sample. The
+ * interpolation is the same sequence of operations as valueNoise2D,
+ * so results match it exactly. Pass a depth of 1 to sample a strip.
+ * `step` may not exceed `scale`.
+ */
+static void sampleValueNoiseGrid (int x0, int z0, int width, int depth, int step, int scale, uint64_t salt, float *out) {
+
+  // Lattice cell (relative to the first) and weight of each grid column
+  int cell_x0 = div_floor(x0, scale);
+  int cell_dx[NOISE_GRID_MAX];
+  NoiseWeight tx[NOISE_GRID_MAX];
+  for (int i = 0; i < width; i ++) {
+    int x = x0 + i * step;
+    cell_dx[i] = div_floor(x, scale) - cell_x0;
+    tx[i] = getNoiseWeight(mod_abs(x, scale), scale);
+  }
+  int cells = cell_dx[width - 1] + 2;
+
+  // Lattice rows below and above the current grid row. As z advances
+  // by at most `scale` per row, the cell row advances by at most one.
+  NoiseValue rows[2][NOISE_GRID_MAX + 1];
+  NoiseValue *lower = rows[0], *upper = rows[1];
+  int cell_z = div_floor(z0, scale);
+  for (int i = 0; i < cells; i ++) {
+    lower[i] = getLatticeValue(cell_x0 + i, cell_z, salt);
+    upper[i] = getLatticeValue(cell_x0 + i, cell_z + 1, salt);
+  }
+
+  for (int j = 0; j < depth; j ++) {
+    int z = z0 + j * step;
+    if (div_floor(z, scale) != cell_z) {
+      cell_z ++;
+      NoiseValue *swap = lower;
+      lower = upper;
+      upper = swap;
+      for (int i = 0; i < cells; i ++) upper[i] = getLatticeValue(cell_x0 + i, cell_z + 1, salt);
+    }
+    NoiseWeight tz = getNoiseWeight(mod_abs(z, scale), scale);
+    float *out_row = out + j * width;
+    for (int i = 0; i < width; i ++) {
+      int c = cell_dx[i];
+      NoiseValue nx0 = lerpNoise(lower[c], lower[c + 1], tx[i]);
+      NoiseValue nx1 = lerpNoise(upper[c], upper[c + 1], tx[i]);
+      out_row[i] = getNoiseFloat(lerpNoise(nx0, nx1, tz));
+    }
+  }
 
-  float nx0 = lerp01(n00, n10, tx);
-  float nx1 = lerp01(n01, n11, tx);
-  return lerp01(nx0, nx1, tz);
 }
 
 static float fractalNoise2D (int x, int z, uint64_t salt) {
@@ -114,10 +237,10 @@ static uint8_t scaleChanceU8 (uint8_t base, int scale) {
   return (uint8_t)v;
 }
 
-static float getRiverChannelMask (int x, int z) {
-  // Coherent river mask shared between biome/height/surface rules.
-  float river_primary = valueNoise2D(x, z, 36, 0xF13A5B9C6D7E8A01ULL) * 2.0f - 1.0f;
-  float river_secondary = valueNoise2D(x, z, 14, 0x29CE4AB1D70685F3ULL) * 2.0f - 1.0f;
+// Shapes the two river noise octaves into the channel mask
+static float getRiverMaskFromNoise (float primary, float secondary) {
+  float river_primary = primary * 2.0f - 1.0f;
+  float river_secondary = secondary * 2.0f - 1.0f;
   float river_abs0 = river_primary < 0.0f ? -river_primary : river_primary;
   float river_abs1 = river_secondary < 0.0f ? -river_secondary : river_secondary;
   float river_shape = river_abs0 * 0.72f + river_abs1 * 0.28f;
@@ -127,19 +250,46 @@ static float getRiverChannelMask (int x, int z) {
   return mask;
 }
 
+static float getRiverChannelMask (int x, int z) {
+  // Coherent river mask shared between biome/height/surface rules.
+  return getRiverMaskFromNoise(
+    valueNoise2D(x, z, 36, 0xF13A5B9C6D7E8A01ULL),
+    valueNoise2D(x, z, 14, 0x29CE4AB1D70685F3ULL)
+  );
+}
+
+// Writes getRiverChannelMask of the 16x16 columns starting at (x0, z0)
+// to `out`, indexed by dx + dz * 16. Uses `scratch` for 256 floats.
+static void getRiverChannelMaskGrid (int x0, int z0, float *out, float *scratch) {
+  sampleValueNoiseGrid(x0, z0, 16, 16, 1, 36, 0xF13A5B9C6D7E8A01ULL, out);
+  sampleValueNoiseGrid(x0, z0, 16, 16, 1, 14, 0x29CE4AB1D70685F3ULL, scratch);
+  for (int i = 0; i < 256; i ++) out[i] = getRiverMaskFromNoise(out[i], scratch[i]);
+}
+
+// Writes the lowest and highest terrain height of the four columns
+// directly adjacent to (x, z)
+static void getNeighborHeightRange (int x, int z, uint8_t *h_min, uint8_t *h_max) {
+  uint8_t h_n = getHeightAt(x, z - 1);
+  uint8_t h_s = getHeightAt(x, z + 1);
+  uint8_t h_w = getHeightAt(x - 1, z);
+  uint8_t h_e = getHeightAt(x + 1, z);
+  *h_min = h_n;
+  *h_max = h_n;
+  if (h_s < *h_min) *h_min = h_s;
+  if (h_w < *h_min) *h_min = h_w;
+  if (h_e < *h_min) *h_min = h_e;
+  if (h_s > *h_max) *h_max = h_s;
+  if (h_w > *h_max) *h_max = h_w;
+  if (h_e > *h_max) *h_max = h_e;
+}
+
+static uint8_t findSummarizedSlope (int x, int z, uint8_t *slope);
+
 static uint8_t getLocalSlopeAt (int x, int z) {
-  int h_n = getHeightAt(x, z - 1);
-  int h_s = getHeightAt(x, z + 1);
-  int h_w = getHeightAt(x - 1, z);
-  int h_e = getHeightAt(x + 1, z);
-  int h_min = h_n;
-  int h_max = h_n;
-  if (h_s < h_min) h_min = h_s;
-  if (h_w < h_min) h_min = h_w;
-  if (h_e < h_min) h_min = h_e;
-  if (h_s > h_max) h_max = h_s;
-  if (h_w > h_max) h_max = h_w;
-  if (h_e > h_max) h_max = h_e;
+  uint8_t slope;
+  if (findSummarizedSlope(x, z, &slope)) return slope;
+  uint8_t h_min, h_max;
+  getNeighborHeightRange(x, z, &h_min, &h_max);
   return (uint8_t)(h_max - h_min);
 }
 
@@ -147,46 +297,129 @@ static float absf_local (float v) {
   return v < 0.0f ? -v : v;
 }
 
-static float samplePseudo3DCaveNoise (int x, int y, int z) {
-  // Cheap 3D-ish field via y-warped 2D samples (faster than full valueNoise3D).
-  float a = valueNoise2D(x + y * 2, z - y * 2, 28, 0xB13D7A9C24E65F01ULL) * 2.0f - 1.0f;
-  float b = valueNoise2D(x - y * 3, z + y, 14, 0xC57E19A40D2B6F83ULL) * 2.0f - 1.0f;
-  float c = valueNoise2D(x + y * 5, z + y * 2, 8, 0x91F24DE37A6BC105ULL) * 2.0f - 1.0f;
+static float combineCaveNoise (float a, float b, float c) {
+  a = a * 2.0f - 1.0f;
+  b = b * 2.0f - 1.0f;
+  c = c * 2.0f - 1.0f;
   return absf_local(a) * 0.50f + absf_local(b) * 0.32f + absf_local(c) * 0.18f;
 }
 
-static uint8_t isCaveOpenAt (int x, int y, int z, uint8_t surface_height) {
+// Samples lattice level `level` of `lattice`, see CaveLattice
+static void sampleCaveLatticeLevel (CaveLattice *lattice, int level) {
+  float grid[50];
+  float *field = lattice->field[level];
+  int y = level * 8;
+
+  // Cheap 3D-ish field via y-warped 2D samples (faster than full valueNoise3D).
+  // The warp is constant across a level, so each octave is sampled as a grid.
+  sampleValueNoiseGrid(lattice->x + y * 2, lattice->z - y * 2, 5, 5, 4, 28, 0xB13D7A9C24E65F01ULL, field);
+  sampleValueNoiseGrid(lattice->x - y * 3, lattice->z + y, 5, 5, 4, 14, 0xC57E19A40D2B6F83ULL, grid);
+  sampleValueNoiseGrid(lattice->x + y * 5, lattice->z + y * 2, 5, 5, 4, 8, 0x91F24DE37A6BC105ULL, grid + 25);
+  for (int i = 0; i < 25; i ++) field[i] = combineCaveNoise(field[i], grid[i], grid[i + 25]);
+
+  // Rare larger caverns.
+  if (level < CAVERN_LATTICE_LEVELS) {
+    sampleValueNoiseGrid(lattice->x + y, lattice->z + y * 2, 5, 5, 4, 52, 0x2AC9157DB03E64F1ULL, lattice->cavern[level]);
+  }
+
+  lattice->levels_ready |= (uint64_t)1 << level;
+}
+
+// Returns the lattice of the chunk holding column (x, z), sampling
+// nothing yet if the calling thread last carved another chunk
+static CaveLattice *getCaveLattice (int x, int z) {
+  CaveLattice *lattice = &worldgen_context->cave_lattice;
+  int chunk_x = div_floor(x, 16) * 16, chunk_z = div_floor(z, 16) * 16;
+  if (!lattice->valid || lattice->x != chunk_x || lattice->z != chunk_z) {
+    lattice->x = chunk_x;
+    lattice->z = chunk_z;
+    lattice->valid = true;
+    lattice->levels_ready = 0;
+  }
+  return lattice;
+}
+
+/**
+ * Returns the cave field at (x, y, z), trilinearly interpolated between
+ * the eight surrounding lattice points. If `cavern` is not NULL, also
+ * writes the interpolated cavern noise there, which y must be below 64 for.
+ */
+static float getCaveField (int x, int y, int z, float *cavern) {
+  CaveLattice *lattice = getCaveLattice(x, z);
+  int level = y >> 3;
+  if (!(lattice->levels_ready & ((uint64_t)1 << level))) sampleCaveLatticeLevel(lattice, level);
+  if (!(lattice->levels_ready & ((uint64_t)1 << (level + 1)))) sampleCaveLatticeLevel(lattice, level + 1);
+
+  int dx = x - lattice->x, dz = z - lattice->z;
+  int i = (dx >> 2) + (dz >> 2) * 5;
+  float tx = (float)(dx & 3) * 0.25f;
+  float tz = (float)(dz & 3) * 0.25f;
+  float ty = (float)(y & 7) * 0.125f;
+
+  const float *lo = lattice->field[level], *hi = lattice->field[level + 1];
+  float field_lo = lerp01(lerp01(lo[i], lo[i + 1], tx), lerp01(lo[i + 5], lo[i + 6], tx), tz);
+  float field_hi = lerp01(lerp01(hi[i], hi[i + 1], tx), lerp01(hi[i + 5], hi[i + 6], tx), tz);
+  if (cavern != NULL) {
+    lo = lattice->cavern[level];
+    hi = lattice->cavern[level + 1];
+    float cavern_lo = lerp01(lerp01(lo[i], lo[i + 1], tx), lerp01(lo[i + 5], lo[i + 6], tx), tz);
+    float cavern_hi = lerp01(lerp01(hi[i], hi[i + 1], tx), lerp01(hi[i + 5], hi[i + 6], tx), tz);
+    *cavern = lerp01(cavern_lo, cavern_hi, ty);
+  }
+  return lerp01(field_lo, field_hi, ty);
+}
+
+static float getCaveRoughness (int x, int z) {
+  return valueNoise2D(x, z, 24, 0xE43BD8217A6F19C5ULL);
+}
+
+// Writes getCaveRoughness of the 16x16 columns starting at (x0, z0)
+// to `out`, indexed by dx + dz * 16
+static void getCaveRoughnessGrid (int x0, int z0, float *out) {
+  sampleValueNoiseGrid(x0, z0, 16, 16, 1, 24, 0xE43BD8217A6F19C5ULL, out);
+}
+
+// `roughness` is getCaveRoughness of the column
+static uint8_t isCaveOpenAt (int x, int y, int z, uint8_t surface_height, float roughness) {
   if (y <= 1) return false;
   if (y >= (int)surface_height - 5) return false;
 
-  float cave_field = samplePseudo3DCaveNoise(x, y, z);
-  float cavern = valueNoise2D(x + y, z + y * 2, 52, 0x2AC9157DB03E64F1ULL);
-  float roughness = valueNoise2D(x, z, 24, 0xE43BD8217A6F19C5ULL);
+  // Caverns are only carved from y = 9 to 55
+  float cavern = 0.0f;
+  float cave_field = getCaveField(x, y, z, y > 8 && y < 56 ? &cavern : NULL);
 
   // Wider cave bands in the lower/mid underground, tighter near surface.
+  // The base threshold makes up for the interpolation smoothing the
+  // field out, which would otherwise carve fewer blocks.
   float depth = (float)((int)surface_height - y);
   float depth_t = depth / 80.0f;
   if (depth_t < 0.0f) depth_t = 0.0f;
   if (depth_t > 1.0f) depth_t = 1.0f;
-  float threshold = 0.20f + depth_t * 0.16f + (roughness - 0.5f) * 0.04f;
+  float threshold = 0.21f + depth_t * 0.16f + (roughness - 0.5f) * 0.04f;
 
   // Rare larger caverns.
-  if (y > 8 && y < 56 && cavern > 0.74f && cave_field < 0.62f) return true;
+  if (y > 8 && y < 56 && cave_field < 0.62f && cavern > 0.74f) return true;
   return cave_field < threshold;
 }
 
-static uint8_t isSurfaceCaveEntranceAt (int x, int y, int z, uint8_t surface_height, uint8_t biome) {
+// Returns true if column (x, z) may hold a cave mouth, see isSurfaceCaveEntranceAt
+static uint8_t isCaveMouthColumn (int x, int z, uint8_t surface_height, uint8_t biome, uint8_t slope) {
   if (biome == W_beach || biome == W_mangrove_swamp) return false;
   if (surface_height < 76) return false;
-  if (y > (int)surface_height || y < (int)surface_height - 3) return false;
 
   // Favor cave mouths on steeper/mountainous terrain.
-  uint8_t slope = getLocalSlopeAt(x, z);
   if (slope < 4) return false;
 
   float ridge = valueNoise2D(x, z, 42, 0x6D239C4FA17BE205ULL);
   if (ridge < 0.68f) return false;
 
+  return true;
+}
+
+// Must only be called on columns that pass isCaveMouthColumn
+static uint8_t isSurfaceCaveEntranceAt (int x, int y, int z, uint8_t surface_height, float roughness) {
+  if (y > (int)surface_height || y < (int)surface_height - 3) return false;
+
   // Create clustered entrances instead of isolated single-block holes.
   float mouth_mask = valueNoise2D(x + y * 2, z - y, 18, 0xA34E716BC59D208FULL);
   if (mouth_mask < 0.80f) return false;
@@ -196,35 +429,96 @@ static uint8_t isSurfaceCaveEntranceAt (int x, int y, int z, uint8_t surface_hei
   for (int depth = 4; depth <= 10; depth++) {
     int cave_y = (int)surface_height - depth;
     if (cave_y <= 2) break;
-    if (isCaveOpenAt(x, cave_y, z, surface_height)) {
+    if (isCaveOpenAt(x, cave_y, z, surface_height, roughness)) {
       connected = true;
       break;
     }
   }
   if (!connected) return false;
 
-  return samplePseudo3DCaveNoise(x, y, z) < 0.34f;
+  return getCaveField(x, y, z, NULL) < 0.35f;
+}
+
+static uint8_t getAquiferLevelFromNoise (float aquifer) {
+  return (uint8_t)(40 + (int)(aquifer * 24.0f)); // 40..64
+}
+
+static uint8_t getAquiferLevel (int x, int z) {
+  return getAquiferLevelFromNoise(valueNoise2D(x, z, 40, 0x7F21CD94AE630B15ULL));
+}
+
+// Writes the aquifer noise of the 16x16 columns starting at (x0, z0)
+// to `out`, to be passed through getAquiferLevelFromNoise
+static void getAquiferNoiseGrid (int x0, int z0, float *out) {
+  sampleValueNoiseGrid(x0, z0, 16, 16, 1, 40, 0x7F21CD94AE630B15ULL, out);
 }
 
-static uint8_t getAquiferFluidAt (int x, int y, int z) {
+// `fluid_level` is getAquiferLevel of the column
+static uint8_t getAquiferFluidAt (int y, uint8_t fluid_level) {
   if (y < 8) return B_lava;
   if (y >= 64) return B_air;
 
-  float aquifer = valueNoise2D(x, z, 40, 0x7F21CD94AE630B15ULL);
-  int fluid_level = 40 + (int)(aquifer * 24.0f); // 40..64
   if (y <= fluid_level) return B_water;
   return B_air;
 }
 
-static uint8_t getSurfaceLavaPoolBlock (int x, int y, int z, uint8_t height, uint8_t biome) {
-  (void)z;
-  if (biome == W_snowy_plains || biome == W_mangrove_swamp) return 0xFF;
-  if (height < 64 || height > 98) return 0xFF;
+// Finds the center of the ruined portal candidate of region (rgx, rgz)
+// and returns the hash its shape is derived from
+static uint32_t getRuinedPortalCandidate (int rgx, int rgz, int *cx, int *cz) {
+  // Notchian reference: structure_set/ruined_portals random_spread spacing=40 separation=15.
+  uint64_t key = ((uint64_t)(uint32_t)rgx << 32) | (uint32_t)rgz;
+  uint32_t h = (uint32_t)splitmix64(key ^ world_seed ^ 34222645u);
+
+  int off_x = (int)(h % 25);               // spacing-separation = 25
+  int off_z = (int)((h >> 8) % 25);
+  int cand_chunk_x = rgx * 40 + off_x;
+  int cand_chunk_z = rgz * 40 + off_z;
+
+  *cx = cand_chunk_x * 16 + 8 + (int)((h >> 16) % 5) - 2;
+  *cz = cand_chunk_z * 16 + 8 + (int)((h >> 20) % 5) - 2;
+  return h;
+}
+
+static void addPlacement (ChunkPlacements *placements, Placement placement) {
+  if (placements->count < CHUNK_PLACEMENTS_MAX) placements->list[placements->count ++] = placement;
+}
+
+/**
+ * Collects the ruined portals and surface lava pools that reach into the
+ * columns from (min_x, min_z) to (max_x, max_z), which must all lie in
+ * one chunk. Candidates are resolved here, once per chunk, so that the
+ * columns only test the few bounding boxes that remain.
+ * Lava pools keep the order of the neighbourhood scan, which decides
+ * between pools that overlap.
+ */
+static void findChunkPlacements (ChunkPlacements *placements, int min_x, int min_z, int max_x, int max_z) {
+  placements->count = 0;
+  int chunk_x = div_floor(min_x, 16);
+  int chunk_z = div_floor(min_z, 16);
+
+  // Ruined portals: one candidate per 40x40 chunk region. Candidates of
+  // adjacent regions are at least 16 chunks apart, so at most one of
+  // them reaches into any chunk.
+  int region_x = div_floor(chunk_x, 40);
+  int region_z = div_floor(chunk_z, 40);
+  for (int rz = -1; rz <= 1; rz++) {
+    for (int rx = -1; rx <= 1; rx++) {
+      Placement portal = { .type = PLACEMENT_RUINED_PORTAL };
+      portal.hash = getRuinedPortalCandidate(region_x + rx, region_z + rz, &portal.x, &portal.z);
+      portal.min_x = portal.x - 5;
+      portal.max_x = portal.x + 5;
+      portal.min_z = portal.z - 5;
+      portal.max_z = portal.z + 5;
+      if (portal.max_x < min_x || portal.min_x > max_x) continue;
+      if (portal.max_z < min_z || portal.min_z > max_z) continue;
+      portal.y = getHeightAt(portal.x, portal.z) + 1;
+      if (portal.y < 60 || portal.y > 116) continue;
+      addPlacement(placements, portal);
+    }
+  }
 
   // Notchian reference: placed_feature/lake_lava_surface uses rarity_filter chance=200.
   // Approximation here: one candidate check per chunk with 1/200 activation.
-  int chunk_x = div_floor(x, 16);
-  int chunk_z = div_floor(z, 16);
   for (int dz = -1; dz <= 1; dz++) {
     for (int dx = -1; dx <= 1; dx++) {
       int cx = chunk_x + dx;
@@ -232,96 +526,87 @@ static uint8_t getSurfaceLavaPoolBlock (int x, int y, int z, uint8_t height, uin
       uint32_t h = getChunkHash((short)cx, (short)cz);
       if (h % 200 != 0) continue;
 
-      int center_x = cx * 16 + (int)((h >> 5) & 15);
-      int center_z = cz * 16 + (int)((h >> 9) & 15);
-      int radius = 1 + (int)((h >> 13) & 2); // 1..3
-
-      int adx = x > center_x ? x - center_x : center_x - x;
-      int adz = z > center_z ? z - center_z : center_z - z;
-      int dist = adx + adz;
-      if (dist > radius) continue;
-
-      uint8_t slope = getLocalSlopeAt(center_x, center_z);
-      if (slope > 3) continue;
-
-      if (dist <= radius - 1) {
-        if (y == height || y == height - 1) return B_lava;
-      } else {
-        if (y == height || y == height - 1) return B_netherrack;
-      }
+      Placement pool = { .type = PLACEMENT_LAVA_POOL, .hash = h };
+      pool.x = cx * 16 + (int)((h >> 5) & 15);
+      pool.z = cz * 16 + (int)((h >> 9) & 15);
+      pool.y = 1 + (int)((h >> 13) & 2); // 1..3
+      pool.min_x = pool.x - pool.y;
+      pool.max_x = pool.x + pool.y;
+      pool.min_z = pool.z - pool.y;
+      pool.max_z = pool.z + pool.y;
+      if (pool.max_x < min_x || pool.min_x > max_x) continue;
+      if (pool.max_z < min_z || pool.min_z > max_z) continue;
+      if (getLocalSlopeAt(pool.x, pool.z) > 3) continue;
+      addPlacement(placements, pool);
     }
   }
-  return 0xFF;
 }
 
-static uint8_t tryRuinedPortalBlock (int x, int y, int z, uint8_t biome, uint8_t *out_block) {
-  if (biome == W_beach || biome == W_mangrove_swamp) return false;
+// Returns the block of a surface lava pool in the top two blocks of
+// column (x, z), or 0xFF if there is no pool
+static uint8_t getSurfaceLavaPoolBlock (const ChunkPlacements *placements, int x, int z, uint8_t height, uint8_t biome) {
+  if (biome == W_snowy_plains || biome == W_mangrove_swamp) return 0xFF;
+  if (height < 64 || height > 98) return 0xFF;
 
-  // Notchian reference: structure_set/ruined_portals random_spread spacing=40 separation=15.
-  int chunk_x = div_floor(x, 16);
-  int chunk_z = div_floor(z, 16);
-  int region_x = div_floor(chunk_x, 40);
-  int region_z = div_floor(chunk_z, 40);
+  for (int i = 0; i < placements->count; i ++) {
+    const Placement *pool = &placements->list[i];
+    if (pool->type != PLACEMENT_LAVA_POOL) continue;
+    int adx = x > pool->x ? x - pool->x : pool->x - x;
+    int adz = z > pool->z ? z - pool->z : pool->z - z;
+    int dist = adx + adz;
+    if (dist > pool->y) continue;
+    return dist <= pool->y - 1 ? B_lava : B_netherrack;
+  }
+  return 0xFF;
+}
 
-  for (int rz = -1; rz <= 1; rz++) {
-    for (int rx = -1; rx <= 1; rx++) {
-      int rgx = region_x + rx;
-      int rgz = region_z + rz;
-      uint64_t key = ((uint64_t)(uint32_t)rgx << 32) | (uint32_t)rgz;
-      uint32_t h = (uint32_t)splitmix64(key ^ world_seed ^ 34222645u);
-
-      int off_x = (int)(h % 25);               // spacing-separation = 25
-      int off_z = (int)((h >> 8) % 25);
-      int cand_chunk_x = rgx * 40 + off_x;
-      int cand_chunk_z = rgz * 40 + off_z;
-
-      int cx = cand_chunk_x * 16 + 8 + (int)((h >> 16) % 5) - 2;
-      int cz = cand_chunk_z * 16 + 8 + (int)((h >> 20) % 5) - 2;
-
-      int adx = x > cx ? x - cx : cx - x;
-      int adz = z > cz ? z - cz : cz - z;
-      if (adx > 5 || adz > 5) continue;
-
-      uint8_t base_y = getHeightAt(cx, cz) + 1;
-      if (base_y < 60 || base_y > 116) continue;
-
-      int orient = (h >> 24) & 1;
-      int lx = orient ? (z - cz) : (x - cx);
-      int lz = orient ? -(x - cx) : (z - cz);
-      int ly = y - base_y;
-
-      // Netherrack spread around the ruin base.
-      if (ly == -1 && lz >= -2 && lz <= 2 && lx >= -3 && lx <= 3) {
-        if (((h >> ((lx + 3) + ((lz + 2) * 3))) & 1) == 0) {
-          *out_block = B_netherrack;
-          return true;
-        }
-      }
+// Returns the ruined portal that may place blocks in column (x, z),
+// or NULL if there is none
+static const Placement *findRuinedPortal (const ChunkPlacements *placements, int x, int z, uint8_t biome) {
+  if (biome == W_beach || biome == W_mangrove_swamp) return NULL;
+
+  for (int i = 0; i < placements->count; i ++) {
+    const Placement *portal = &placements->list[i];
+    if (portal->type != PLACEMENT_RUINED_PORTAL) continue;
+    if (x < portal->min_x || x > portal->max_x) continue;
+    if (z < portal->min_z || z > portal->max_z) continue;
+    return portal;
+  }
+  return NULL;
+}
 
-      // Simplified ruined frame (4x5), partially broken.
-      if (lz == 0) {
-        uint8_t frame = false;
-        if ((lx == -1 || lx == 2) && ly >= 0 && ly <= 4) frame = true;
-        if ((ly == 0 || ly == 4) && lx >= -1 && lx <= 2) frame = true;
-        if (frame) {
-          uint32_t bh = (uint32_t)splitmix64(((uint64_t)(lx + 8) << 32) ^ ((uint64_t)(ly + 16) << 8) ^ (uint64_t)(h));
-          if ((bh & 7) == 0) return false; // broken piece
-          *out_block = B_obsidian;
-          return true;
-        }
-      }
+// Returns the block that `portal` places at (x, y, z), or 0xFF if it
+// leaves that block to the terrain
+static uint8_t getRuinedPortalBlock (const Placement *portal, int x, int y, int z) {
+  uint32_t h = portal->hash;
+  int orient = (h >> 24) & 1;
+  int lx = orient ? (z - portal->z) : (x - portal->x);
+  int lz = orient ? -(x - portal->x) : (z - portal->z);
+  int ly = y - portal->y;
+
+  // Netherrack spread around the ruin base.
+  if (ly == -1 && lz >= -2 && lz <= 2 && lx >= -3 && lx <= 3) {
+    if (((h >> ((lx + 3) + ((lz + 2) * 3))) & 1) == 0) return B_netherrack;
+  }
 
-      // Occasional lava spill near base.
-      if (ly == 0 && lz == 1 && lx >= -1 && lx <= 1) {
-        if (((h >> 27) & 3) == 0) {
-          *out_block = B_lava;
-          return true;
-        }
-      }
+  // Simplified ruined frame (4x5), partially broken.
+  if (lz == 0) {
+    uint8_t frame = false;
+    if ((lx == -1 || lx == 2) && ly >= 0 && ly <= 4) frame = true;
+    if ((ly == 0 || ly == 4) && lx >= -1 && lx <= 2) frame = true;
+    if (frame) {
+      uint32_t bh = (uint32_t)splitmix64(((uint64_t)(lx + 8) << 32) ^ ((uint64_t)(ly + 16) << 8) ^ (uint64_t)(h));
+      if ((bh & 7) == 0) return 0xFF; // broken piece
+      return B_obsidian;
     }
   }
 
-  return false;
+  // Occasional lava spill near base.
+  if (ly == 0 && lz == 1 && lx >= -1 && lx <= 1) {
+    if (((h >> 27) & 3) == 0) return B_lava;
+  }
+
+  return 0xFF;
 }
 
 static uint8_t shouldPlaceRiverSurfaceWater (int x, int z, uint8_t height, uint8_t biome, float river_mask) {
@@ -345,7 +630,8 @@ static uint32_t getCoordinateHash (int x, int y, int z) {
   return splitmix64(h ^ (uint32_t)z);
 }
 
-static uint8_t isWaterfallSpringCandidate (int x, int z, uint8_t height, uint8_t biome) {
+// `h_min` is the lowest height among the four neighbours of the column
+static uint8_t isWaterfallSpringCandidate (int x, int z, uint8_t height, uint8_t biome, uint8_t h_min) {
   if (biome == W_desert || biome == W_beach) return false;
   if (height < 76) return false;
 
@@ -354,14 +640,6 @@ static uint8_t isWaterfallSpringCandidate (int x, int z, uint8_t height, uint8_t
   if (moisture < 0.52f || spring < 0.82f) return false;
 
   // Require a local steep edge so springs look like cliff waterfalls.
-  int h_n = getHeightAt(x, z - 1);
-  int h_s = getHeightAt(x, z + 1);
-  int h_w = getHeightAt(x - 1, z);
-  int h_e = getHeightAt(x + 1, z);
-  int h_min = h_n;
-  if (h_s < h_min) h_min = h_s;
-  if (h_w < h_min) h_min = h_w;
-  if (h_e < h_min) h_min = h_e;
   if ((int)height - h_min < 6) return false;
 
   return true;
@@ -395,11 +673,25 @@ typedef struct {
   float weirdness;
 } ClimateTarget;
 
+static float combineClimateOctaves (float n0, float n1, float n2) {
+  return (n0 * 0.62f + n1 * 0.26f + n2 * 0.12f) * 2.0f - 1.0f;
+}
+
 static float sampleClimateAxis (int qx, int qz, int scale_quarts, uint64_t salt) {
   float n0 = valueNoise2D(qx, qz, scale_quarts, salt ^ 0x9E3779B97F4A7C15ULL);
   float n1 = valueNoise2D(qx, qz, scale_quarts / 2, salt ^ 0xD1B54A32D192ED03ULL);
   float n2 = valueNoise2D(qx, qz, scale_quarts / 4, salt ^ 0x94D049BB133111EBULL);
-  return (n0 * 0.62f + n1 * 0.26f + n2 * 0.12f) * 2.0f - 1.0f;
+  return combineClimateOctaves(n0, n1, n2);
+}
+
+// Writes sampleClimateAxis of the `count` quarts `step` apart starting
+// at (qx0, qz) along x to `out`. `count` may not exceed NOISE_GRID_MAX.
+static void sampleClimateAxisRow (int qx0, int qz, int step, int count, int scale_quarts, uint64_t salt, float *out) {
+  float n1[NOISE_GRID_MAX], n2[NOISE_GRID_MAX];
+  sampleValueNoiseGrid(qx0, qz, count, 1, step, scale_quarts, salt ^ 0x9E3779B97F4A7C15ULL, out);
+  sampleValueNoiseGrid(qx0, qz, count, 1, step, scale_quarts / 2, salt ^ 0xD1B54A32D192ED03ULL, n1);
+  sampleValueNoiseGrid(qx0, qz, count, 1, step, scale_quarts / 4, salt ^ 0x94D049BB133111EBULL, n2);
+  for (int i = 0; i < count; i ++) out[i] = combineClimateOctaves(out[i], n1[i], n2[i]);
 }
 
 static ClimatePoint sampleClimatePoint (short chunk_x, short chunk_z) {
@@ -429,13 +721,13 @@ static float climateDistanceSq (ClimatePoint p, ClimateTarget t) {
   return dt * dt * 1.25f + dh * dh * 0.95f + dc * dc * 1.35f + de * de * 0.85f + dw * dw * 0.70f;
 }
 
-static uint8_t getBiomeFromClimateUncached (short x, short z) {
+// Picks the biome of minichunk (x, z) from its climate and the
+// noise of the river ribbons running through it
+static uint8_t getBiomeFromClimate (short x, short z, ClimatePoint climate, float river_noise) {
   if (isNetherZone(z * CHUNK_SIZE)) return W_desert;
   // Keep spawn approachable, but allow nearby biome diversity.
   if (abs((int)x) <= 10 && abs((int)z) <= 10) return W_plains;
 
-  ClimatePoint climate = sampleClimatePoint(x, z);
-
   // Limited biome set: fold ocean/coast buckets into beach proxy.
   if (climate.continentalness < -0.40f) return W_beach;
   if (climate.continentalness < -0.20f && climate.erosion > -0.10f) return W_beach;
@@ -474,11 +766,6 @@ static uint8_t getBiomeFromClimateUncached (short x, short z) {
   }
 
   // Narrow river/coastal ribbons (still deterministic by seed).
-  float river_noise = sampleClimateAxis(
-    div_floor(x * CHUNK_SIZE, 4),
-    div_floor(z * CHUNK_SIZE, 4),
-    48, 0xF13A5B9C6D7E8A01ULL
-  );
   float river_band = river_noise < 0.0f ? -river_noise : river_noise;
   if (climate.continentalness > -0.05f && climate.continentalness < 0.28f && river_band < 0.035f) {
     return W_beach;
@@ -493,34 +780,116 @@ static uint8_t getBiomeFromClimateUncached (short x, short z) {
   return best;
 }
 
-uint8_t getChunkBiome (short x, short z) {
+static float sampleRiverNoise (short x, short z) {
+  return sampleClimateAxis(
+    div_floor(x * CHUNK_SIZE, 4),
+    div_floor(z * CHUNK_SIZE, 4),
+    48, 0xF13A5B9C6D7E8A01ULL
+  );
+}
+
+/**
+ * Fills in the biomes of row `dz` of `tile`. Along the row, the climate
+ * quarts of the minichunks are evenly spaced, so every climate axis is
+ * sampled in strips that share their lattice hashes. A row costs less
+ * than sampling a single minichunk's climate on its own.
+ */
+static void fillBiomeTileRow (BiomeTile *tile, int dz) {
+  int anchor_x0 = tile->x * BIOME_TILE_SIDE;
+  short z = tile->z * BIOME_TILE_SIDE + dz;
+  uint8_t *biomes = tile->biomes + dz * BIOME_TILE_SIDE;
+
+  // Quarts are only evenly spaced if minichunks span whole quarts, and
+  // strips may not step over more than the smallest noise scale
+  if (CHUNK_SIZE % 4 != 0 || CHUNK_SIZE / 4 > 12) {
+    for (int dx = 0; dx < BIOME_TILE_SIDE; dx ++) {
+      short x = anchor_x0 + dx;
+      biomes[dx] = getBiomeFromClimate(x, z, sampleClimatePoint(x, z), sampleRiverNoise(x, z));
+    }
+    return;
+  }
+
+  // Quart step from one minichunk to the next, and quart positions of
+  // the center (climate) and origin (rivers) of the first minichunk
+  int step = CHUNK_SIZE / 4;
+  int center_qx = div_floor(anchor_x0 * CHUNK_SIZE + CHUNK_SIZE / 2, 4);
+  int center_qz = div_floor(z * CHUNK_SIZE + CHUNK_SIZE / 2, 4);
+  int origin_qx = div_floor(anchor_x0 * CHUNK_SIZE, 4);
+  int origin_qz = div_floor(z * CHUNK_SIZE, 4);
+
+  float axes[6][NOISE_GRID_MAX];
+  for (int dx0 = 0; dx0 < BIOME_TILE_SIDE; dx0 += NOISE_GRID_MAX) {
+    int count = BIOME_TILE_SIDE - dx0;
+    if (count > NOISE_GRID_MAX) count = NOISE_GRID_MAX;
+    int qx = center_qx + dx0 * step;
+    // Same axes, scales and salts as sampleClimatePoint
+    sampleClimateAxisRow(qx, center_qz, step, count, 96, 0xA7F3D95B6C1209E1ULL, axes[0]);
+    sampleClimateAxisRow(qx, center_qz, step, count, 96, 0xC6BC279692B5CC83ULL, axes[1]);
+    sampleClimateAxisRow(qx, center_qz, step, count, 128, 0x8EBC6AF09C88C6E3ULL, axes[2]);
+    sampleClimateAxisRow(qx, center_qz, step, count, 96, 0x8AF1C94372DE10B5ULL, axes[3]);
+    sampleClimateAxisRow(qx, center_qz, step, count, 64, 0xD7A9F13E21C4B6A5ULL, axes[4]);
+    sampleClimateAxisRow(origin_qx + dx0 * step, origin_qz, step, count, 48, 0xF13A5B9C6D7E8A01ULL, axes[5]);
+    for (int i = 0; i < count; i ++) {
+      ClimatePoint climate = {
+        .temperature = axes[0][i],
+        .humidity = axes[1][i],
+        .continentalness = axes[2][i],
+        .erosion = axes[3][i],
+        .weirdness = axes[4][i]
+      };
+      biomes[dx0 + i] = getBiomeFromClimate(anchor_x0 + dx0 + i, z, climate, axes[5][i]);
+    }
+  }
+}
 
-  // Biome lookup is hot-path for chunk generation; keep a tiny fixed cache.
-  uint32_t h = hashChunkXZ(x, z);
-  int first_free = -1;
-  for (int i = 0; i < BIOME_CACHE_CAPACITY; i ++) {
-    int slot = (int)((h + (uint32_t)i) % BIOME_CACHE_CAPACITY);
-    BiomeCacheEntry *entry = &biome_cache[slot];
-    if (!entry->used) {
-      if (first_free == -1) first_free = slot;
+// Returns the tile of biomes at tile coordinates (tile_x, tile_z),
+// taking over the least recently used tile of the context if needed
+static BiomeTile *getBiomeTile (WorldgenContext *context, short tile_x, short tile_z) {
+  int victim = 0;
+  for (int i = 0; i < BIOME_TILE_CACHE_SIZE; i ++) {
+    BiomeTile *tile = &context->biome_tiles[i];
+    if (!tile->valid || (tile->x == tile_x && tile->z == tile_z)) {
+      victim = i;
       break;
     }
-    if (entry->x == x && entry->z == z) return entry->biome;
+    if (tile->last_use < context->biome_tiles[victim].last_use) victim = i;
   }
 
-  uint8_t biome = getBiomeFromClimateUncached(x, z);
-  int slot = first_free;
-  if (slot == -1) slot = (int)(h % BIOME_CACHE_CAPACITY);
-  biome_cache[slot].used = true;
-  biome_cache[slot].x = x;
-  biome_cache[slot].z = z;
-  biome_cache[slot].biome = biome;
-  return biome;
+  BiomeTile *tile = &context->biome_tiles[victim];
+  if (!tile->valid || tile->x != tile_x || tile->z != tile_z) {
+    tile->x = tile_x;
+    tile->z = tile_z;
+    tile->valid = true;
+    tile->rows_ready = 0;
+  }
+  tile->last_use = ++ context->biome_tile_clock;
+  context->biome_tile_last = victim;
+  return tile;
+}
+
+uint8_t getChunkBiome (short x, short z) {
+
+  // Biome lookup is hot-path for chunk generation, and nearly always
+  // lands in the same tile as the one before
+  WorldgenContext *context = worldgen_context;
+  short tile_x = div_floor(x, BIOME_TILE_SIDE);
+  short tile_z = div_floor(z, BIOME_TILE_SIDE);
+  BiomeTile *tile = &context->biome_tiles[context->biome_tile_last];
+  if (!tile->valid || tile->x != tile_x || tile->z != tile_z) {
+    tile = getBiomeTile(context, tile_x, tile_z);
+  }
+  // Rows are filled on first use, so scattered lookups don't pay for
+  // whole tiles they barely touch
+  int dz = mod_abs(z, BIOME_TILE_SIDE);
+  if (!(tile->rows_ready & ((uint32_t)1 << dz))) {
+    fillBiomeTileRow(tile, dz);
+    tile->rows_ready |= (uint32_t)1 << dz;
+  }
+  return tile->biomes[mod_abs(x, BIOME_TILE_SIDE) + dz * BIOME_TILE_SIDE];
 
 }
 
-uint8_t getCornerHeight (short anchor_x, short anchor_z, uint32_t hash, uint8_t biome) {
-  (void)hash;
+static uint8_t getCornerHeightUncached (short anchor_x, short anchor_z, uint8_t biome) {
 
   // Vanilla-like macro signals in [-1..1]:
   // continentalness (landmass), erosion (roughness), ridges (mountain chains).
@@ -687,6 +1056,36 @@ uint8_t getCornerHeight (short anchor_x, short anchor_z, uint32_t hash, uint8_t
   return (uint8_t)(height_f + 0.5f);
 }
 
+static CornerHeightCacheEntry *getCornerHeightCacheEntry (short anchor_x, short anchor_z) {
+  unsigned mask = CORNER_HEIGHT_CACHE_SIDE - 1;
+  unsigned slot = ((unsigned)anchor_x & mask) + ((unsigned)anchor_z & mask) * CORNER_HEIGHT_CACHE_SIDE;
+  return &worldgen_context->corner_height_cache[slot];
+}
+
+// Returns the terrain height at the corner of minichunk anchor (x, z).
+// Every column interpolates four of these, and neighbouring lookups
+// (slopes, spawn checks, features) land on the same few anchors, so
+// each context memoizes them in a small tile indexed by anchor position.
+// The biome is a function of the anchor alone, so (x, z) is the full key.
+uint8_t getCornerHeight (short anchor_x, short anchor_z, uint8_t biome) {
+  CornerHeightCacheEntry *entry = getCornerHeightCacheEntry(anchor_x, anchor_z);
+  if (entry->used && entry->x == anchor_x && entry->z == anchor_z) return entry->height;
+
+  uint8_t height = getCornerHeightUncached(anchor_x, anchor_z, biome);
+  entry->used = true;
+  entry->x = anchor_x;
+  entry->z = anchor_z;
+  entry->height = height;
+  return height;
+}
+
+// Same as getCornerHeight, but only looks up the biome on a cache miss
+static uint8_t getAnchorCornerHeight (short anchor_x, short anchor_z) {
+  CornerHeightCacheEntry *entry = getCornerHeightCacheEntry(anchor_x, anchor_z);
+  if (entry->used && entry->x == anchor_x && entry->z == anchor_z) return entry->height;
+  return getCornerHeight(anchor_x, anchor_z, getChunkBiome(anchor_x, anchor_z));
+}
+
 uint8_t interpolate (uint8_t a, uint8_t b, uint8_t c, uint8_t d, int x, int z) {
   uint16_t top    = a * (CHUNK_SIZE - x) + b * x;
   uint16_t bottom = c * (CHUNK_SIZE - x) + d * x;
@@ -699,22 +1098,20 @@ uint8_t interpolate (uint8_t a, uint8_t b, uint8_t c, uint8_t d, int x, int z) {
 uint8_t getHeightAtFromAnchors (int rx, int rz, ChunkAnchor *anchor_ptr) {
 
   if (rx == 0 && rz == 0) {
-    int height = getCornerHeight(anchor_ptr[0].x, anchor_ptr[0].z, anchor_ptr[0].hash, anchor_ptr[0].biome);
+    int height = getCornerHeight(anchor_ptr[0].x, anchor_ptr[0].z, anchor_ptr[0].biome);
     if (height > 67) return height - 1;
   }
   return interpolate(
-    getCornerHeight(anchor_ptr[0].x, anchor_ptr[0].z, anchor_ptr[0].hash, anchor_ptr[0].biome),
-    getCornerHeight(anchor_ptr[1].x, anchor_ptr[1].z, anchor_ptr[1].hash, anchor_ptr[1].biome),
+    getCornerHeight(anchor_ptr[0].x, anchor_ptr[0].z, anchor_ptr[0].biome),
+    getCornerHeight(anchor_ptr[1].x, anchor_ptr[1].z, anchor_ptr[1].biome),
     getCornerHeight(
       anchor_ptr[16 / CHUNK_SIZE + 1].x,
       anchor_ptr[16 / CHUNK_SIZE + 1].z,
-      anchor_ptr[16 / CHUNK_SIZE + 1].hash,
       anchor_ptr[16 / CHUNK_SIZE + 1].biome
     ),
     getCornerHeight(
       anchor_ptr[16 / CHUNK_SIZE + 2].x,
       anchor_ptr[16 / CHUNK_SIZE + 2].z,
-      anchor_ptr[16 / CHUNK_SIZE + 2].hash,
       anchor_ptr[16 / CHUNK_SIZE + 2].biome
     ),
     rx, rz
@@ -722,17 +1119,17 @@ uint8_t getHeightAtFromAnchors (int rx, int rz, ChunkAnchor *anchor_ptr) {
 
 }
 
-uint8_t getHeightAtFromHash (int rx, int rz, int _x, int _z, uint32_t chunk_hash, uint8_t biome) {
+uint8_t getHeightAtFromAnchor (int rx, int rz, int _x, int _z, uint8_t biome) {
 
   if (rx == 0 && rz == 0) {
-    int height = getCornerHeight(_x, _z, chunk_hash, biome);
+    int height = getCornerHeight(_x, _z, biome);
     if (height > 67) return height - 1;
   }
   return interpolate(
-    getCornerHeight(_x, _z, chunk_hash, biome),
-    getCornerHeight(_x + 1, _z, getChunkHash(_x + 1, _z), getChunkBiome(_x + 1, _z)),
-    getCornerHeight(_x, _z + 1, getChunkHash(_x, _z + 1), getChunkBiome(_x, _z + 1)),
-    getCornerHeight(_x + 1, _z + 1, getChunkHash(_x + 1, _z + 1), getChunkBiome(_x + 1, _z + 1)),
+    getCornerHeight(_x, _z, biome),
+    getAnchorCornerHeight(_x + 1, _z),
+    getAnchorCornerHeight(_x, _z + 1),
+    getAnchorCornerHeight(_x + 1, _z + 1),
     rx, rz
   );
 
@@ -746,38 +1143,174 @@ uint8_t getHeightAt (int x, int z) {
   int _z = div_floor(z, CHUNK_SIZE);
   int rx = mod_abs(x, CHUNK_SIZE);
   int rz = mod_abs(z, CHUNK_SIZE);
-  uint32_t chunk_hash = getChunkHash(_x, _z);
-  uint8_t biome = getChunkBiome(_x, _z);
 
-  return getHeightAtFromHash(rx, rz, _x, _z, chunk_hash, biome);
+  // Corners are usually cached, in which case the biome of the anchor
+  // is not needed
+  uint8_t corner = getAnchorCornerHeight(_x, _z);
+  if (rx == 0 && rz == 0 && corner > 67) return corner - 1;
+  return interpolate(
+    corner,
+    getAnchorCornerHeight(_x + 1, _z),
+    getAnchorCornerHeight(_x, _z + 1),
+    getAnchorCornerHeight(_x + 1, _z + 1),
+    rx, rz
+  );
+
+}
+
+// Returns the block placed on top of land column (x, z), at y = height + 1.
+// `h_min` is the lowest height among the four neighbours of the column.
+static uint8_t getSurfaceCoverBlock (int x, int z, uint8_t height, uint8_t biome, uint8_t variant, float river_mask, uint8_t h_min) {
+  int y = height + 1;
+  if (height >= 64) {
+    // Fill only coherent low-altitude river beds.
+    if (shouldPlaceRiverSurfaceWater(x, z, height, biome, river_mask)) {
+      return B_water;
+    }
+
+    if (isWaterfallSpringCandidate(x, z, height, biome, h_min)) return B_water;
+
+    // Surface decorator pass: deterministic biome-specific patches/clusters.
+    uint8_t deco = (uint8_t)((getCoordinateHash(x, 0, z) >> 9) & 255);
+    uint8_t deco_hi = (uint8_t)((getCoordinateHash(x, 9, z) >> 11) & 255);
+    uint8_t flowers_plain_chance = scaleChanceU8(
+      WORLDGEN_PLAINS_FLOWER_CHANCE,
+      WORLDGEN_DECOR_DENSITY_SCALE * WORLDGEN_FLOWER_DENSITY_SCALE
+    );
+    uint8_t mushrooms_plain_chance = scaleChanceU8(
+      WORLDGEN_PLAINS_MUSHROOM_CHANCE,
+      WORLDGEN_MUSHROOM_DENSITY_SCALE
+    );
+    uint8_t mushrooms_swamp_chance = scaleChanceU8(
+      WORLDGEN_SWAMP_MUSHROOM_CHANCE,
+      WORLDGEN_MUSHROOM_DENSITY_SCALE
+    );
+    uint8_t surface = getSurfaceBlockForBiome(biome, variant, height);
+    if (biome == W_plains) {
+      if (surface == B_grass_block) {
+        // Vanilla-like pumpkin patches: rare, local clusters, not isolated noise.
+        float pumpkin_patch = valueNoise2D(
+          x, z, WORLDGEN_PUMPKIN_PATCH_SCALE, 0x36C492A5E17B4D09ULL
+        );
+        if (
+          pumpkin_patch > ((float)WORLDGEN_PUMPKIN_PATCH_THRESHOLD / 100.0f) &&
+          deco < WORLDGEN_PLAINS_PUMPKIN_CHANCE
+        ) {
+          return B_pumpkin;
+        }
+
+        // Flowers spawn in patch regions, with local per-column randomness.
+        float flower_patch = valueNoise2D(
+          x, z, WORLDGEN_FLOWER_PATCH_SCALE, 0x91BD3EF0762CA845ULL
+        );
+        if (
+          flower_patch > ((float)WORLDGEN_FLOWER_PATCH_THRESHOLD / 100.0f) &&
+          deco < flowers_plain_chance
+        ) return getFlowerBlockFromHash(getCoordinateHash(x, 1, z), W_plains);
+
+        if (deco < mushrooms_plain_chance) {
+          return ((getCoordinateHash(x, 5, z) & 1) == 0) ? B_brown_mushroom : B_red_mushroom;
+        }
+
+        if (deco < scaleChanceU8(WORLDGEN_PLAINS_GRASS_CHANCE, WORLDGEN_DECOR_DENSITY_SCALE)) {
+          if (deco_hi < 84) return B_fern;
+          return B_short_grass;
+        }
+      }
+    } else if (biome == W_desert) {
+      if (deco < scaleChanceU8(WORLDGEN_DESERT_DEAD_BUSH_CHANCE, WORLDGEN_DECOR_DENSITY_SCALE)) return B_dead_bush;
+    } else if (biome == W_mangrove_swamp) {
+      if (deco < mushrooms_swamp_chance && y > 64) {
+        return ((getCoordinateHash(x, 8, z) & 1) == 0) ? B_brown_mushroom : B_red_mushroom;
+      }
+      if (deco < scaleChanceU8((uint8_t)(WORLDGEN_SWAMP_GRASS_CHANCE / 2), WORLDGEN_DECOR_DENSITY_SCALE) && y > 64) return B_fern;
+      if (deco < scaleChanceU8(WORLDGEN_SWAMP_GRASS_CHANCE, WORLDGEN_DECOR_DENSITY_SCALE) && y > 64) return B_short_grass;
+    }
+  }
+  if (biome == W_snowy_plains) return B_snow;
+  return B_air;
+}
+
+// Returns the block at the top of land column (x, z), at y = height
+static uint8_t getSurfaceTopBlock (uint8_t height, uint8_t biome, uint8_t variant, float river_mask, uint8_t slope) {
+  // Vanilla-like surface-rule approximation:
+  // rivers get gravel/sand beds, steep zones expose stone.
+  if (river_mask > 0.74f && biome != W_desert && biome != W_beach && height >= 58 && height <= 82) {
+    return B_gravel;
+  }
+  if (slope >= 7 && height >= 76 && biome != W_mangrove_swamp) {
+    return B_stone;
+  }
+  return getSurfaceBlockForBiome(biome, variant, height);
+}
+
+/**
+ * Fills in the decisions about column (x, z) that do not depend on y.
+ * `h_min` and `h_max` are the lowest and highest heights among the four
+ * neighbours of the column, and `placements` must hold those reaching
+ * into it. If `near_surface` is false, only blocks more than 3 below the
+ * surface may be generated from the column, and neither those nor
+ * `river_mask` are needed.
+ * The caller sets the cave roughness and aquifer level.
+ */
+static void initChunkColumn (ChunkColumn *column, int x, int z, ChunkAnchor anchor, const ChunkPlacements *placements, uint8_t height, uint8_t h_min, uint8_t h_max, float river_mask, uint8_t near_surface) {
+  column->height = height;
+  column->flags = findRuinedPortal(placements, x, z, anchor.biome) ? COLUMN_NEAR_PORTAL : 0;
+  column->lava_pool = 0xFF;
+  column->surface = B_air;
+  column->cover = B_air;
+  if (!near_surface) return;
 
+  uint8_t variant = (anchor.hash >> 20) & 3;
+  uint8_t slope = h_max - h_min;
+  column->lava_pool = getSurfaceLavaPoolBlock(placements, x, z, height, anchor.biome);
+  if (isCaveMouthColumn(x, z, height, anchor.biome, slope)) column->flags |= COLUMN_CAVE_MOUTH;
+  if (height >= 63) {
+    column->surface = getSurfaceTopBlock(height, anchor.biome, variant, river_mask, slope);
+    column->cover = getSurfaceCoverBlock(x, z, height, anchor.biome, variant, river_mask, h_min);
+  }
 }
 
-uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor anchor, ChunkFeature feature, uint8_t height) {
+// Bounds the blocks above ground of a column: sea water ends at 63,
+// decorations and cacti at height + 3, trees 6 above their feature base
+// and ruined portals 4 above their base, which is at most 117
+static uint8_t getColumnAirTop (const ChunkColumn *column, ChunkFeature feature) {
+  int air_top = column->height + 3;
+  if (air_top < 63) air_top = 63;
+  if (feature.y != 0xFF && feature.y + 6 > air_top) air_top = feature.y + 6;
+  if ((column->flags & COLUMN_NEAR_PORTAL) && air_top < 121) air_top = 121;
+  return (uint8_t)air_top;
+}
+
+/**
+ * Returns the terrain block at (x, y, z) in a minichunk of biome `biome`,
+ * given its anchor and feature, the precomputed decisions about its
+ * column and the placements reaching into it. Only ever inlined into the terrain kernels below, which pass a
+ * constant `biome`, so each kernel keeps just the branches of its biome.
+ */
+static inline __attribute__((always_inline)) uint8_t getBiomeTerrainAt (int x, int y, int z, int rx, int rz, ChunkAnchor anchor, ChunkFeature feature, const ChunkColumn *column, const ChunkPlacements *placements, uint8_t biome) {
   uint8_t variant = (anchor.hash >> 20) & 3;
-  float river_mask = getRiverChannelMask(x, z);
-  uint8_t slope = 0;
+  uint8_t height = column->height;
 
   // Structure pass first so ruined portal blocks can intentionally override
   // base terrain/decor on the target columns.
-  uint8_t structure_block = 0xFF;
-  if (tryRuinedPortalBlock(x, y, z, anchor.biome, &structure_block)) {
-    return structure_block;
+  if (column->flags & COLUMN_NEAR_PORTAL) {
+    uint8_t structure_block = getRuinedPortalBlock(findRuinedPortal(placements, x, z, biome), x, y, z);
+    if (structure_block != 0xFF) return structure_block;
   }
 
   // Surface lava pools are a rare top-layer feature; apply before regular
   // surface composition so lava/netherrack can replace dirt/grass cleanly.
   if (y >= (int)height - 1 && y <= (int)height) {
-    uint8_t lava_pool_block = getSurfaceLavaPoolBlock(x, y, z, height, anchor.biome);
-    if (lava_pool_block != 0xFF) return lava_pool_block;
+    if (column->lava_pool != 0xFF) return column->lava_pool;
   }
 
   // Allow occasional mountain cave mouths that are visible from surface.
-  if (y <= (int)height && y >= (int)height - 3) {
-    if (isSurfaceCaveEntranceAt(x, y, z, height, anchor.biome)) return B_air;
+  if (y <= (int)height && y >= (int)height - 3 && (column->flags & COLUMN_CAVE_MOUTH)) {
+    if (isSurfaceCaveEntranceAt(x, y, z, height, column->cave_roughness)) return B_air;
   }
 
-  if (y >= 64 && y >= height && feature.y != 255) switch (anchor.biome) {
+  if (y >= 64 && y >= height && feature.y != 255) switch (biome) {
     case W_plains:
     case W_mangrove_swamp: {
       // Biome-aware tree pass with deterministic silhouette and leaf mix.
@@ -790,7 +1323,7 @@ uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor
       uint8_t dz = z > feature.z ? z - feature.z : feature.z - z;
       if (dx > 2 || dz > 2) break;
 
-      if (anchor.biome == W_mangrove_swamp) {
+      if (biome == W_mangrove_swamp) {
         if (x == feature.x && z == feature.z && y == 64 && height < 63) return B_lily_pad;
         if (y == height + 1) {
           uint8_t mdx = x > feature.x ? x - feature.x : feature.x - x;
@@ -803,7 +1336,7 @@ uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor
       uint8_t tall = (feature.variant >> 2) & 1;
       uint8_t crown = (feature.variant >> 3) & 1;
       uint8_t trunk_h = (uint8_t)(4 + tall + ((tree_type == 1) ? 1 : 0));
-      uint8_t base_block = (anchor.biome == W_mangrove_swamp) ? B_mud : B_dirt;
+      uint8_t base_block = (biome == W_mangrove_swamp) ? B_mud : B_dirt;
 
       uint8_t leaf_primary = B_oak_leaves;
       uint8_t leaf_secondary = B_oak_leaves;
@@ -830,7 +1363,7 @@ uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor
       if (rel == 2 && dx <= 1 && dz <= 1) return leaf_primary;
       if (rel == 3 && crown && dx == 0 && dz == 0) return leaf_secondary;
 
-      if (y == height) return getSurfaceBlockForBiome(anchor.biome, variant, height);
+      if (y == height) return getSurfaceBlockForBiome(biome, variant, height);
       return B_air;
     }
 
@@ -859,94 +1392,14 @@ uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor
 
   // Handle surface-level terrain (the very topmost blocks)
   if (height >= 63) {
-    if (y == height) {
-      // Vanilla-like surface-rule approximation:
-      // rivers get gravel/sand beds, steep zones expose stone.
-      if (river_mask > 0.74f && anchor.biome != W_desert && anchor.biome != W_beach && height >= 58 && height <= 82) {
-        return B_gravel;
-      }
-      slope = getLocalSlopeAt(x, z);
-      if (slope >= 7 && height >= 76 && anchor.biome != W_mangrove_swamp) {
-        return B_stone;
-      }
-      return getSurfaceBlockForBiome(anchor.biome, variant, height);
-    }
-    if (y == height + 1 && height >= 64) {
-      // Fill only coherent low-altitude river beds.
-      if (shouldPlaceRiverSurfaceWater(x, z, height, anchor.biome, river_mask)) {
-        return B_water;
-      }
-
-      if (isWaterfallSpringCandidate(x, z, height, anchor.biome)) return B_water;
-
-      // Surface decorator pass: deterministic biome-specific patches/clusters.
-      uint8_t deco = (uint8_t)((getCoordinateHash(x, 0, z) >> 9) & 255);
-      uint8_t deco_hi = (uint8_t)((getCoordinateHash(x, 9, z) >> 11) & 255);
-      uint8_t flowers_plain_chance = scaleChanceU8(
-        WORLDGEN_PLAINS_FLOWER_CHANCE,
-        WORLDGEN_DECOR_DENSITY_SCALE * WORLDGEN_FLOWER_DENSITY_SCALE
-      );
-      uint8_t mushrooms_plain_chance = scaleChanceU8(
-        WORLDGEN_PLAINS_MUSHROOM_CHANCE,
-        WORLDGEN_MUSHROOM_DENSITY_SCALE
-      );
-      uint8_t mushrooms_swamp_chance = scaleChanceU8(
-        WORLDGEN_SWAMP_MUSHROOM_CHANCE,
-        WORLDGEN_MUSHROOM_DENSITY_SCALE
-      );
-      uint8_t surface = getSurfaceBlockForBiome(anchor.biome, variant, height);
-      if (anchor.biome == W_plains) {
-        if (surface == B_grass_block) {
-          // Vanilla-like pumpkin patches: rare, local clusters, not isolated noise.
-          float pumpkin_patch = valueNoise2D(
-            x, z, WORLDGEN_PUMPKIN_PATCH_SCALE, 0x36C492A5E17B4D09ULL
-          );
-          if (
-            pumpkin_patch > ((float)WORLDGEN_PUMPKIN_PATCH_THRESHOLD / 100.0f) &&
-            deco < WORLDGEN_PLAINS_PUMPKIN_CHANCE
-          ) {
-            return B_pumpkin;
-          }
-
-          // Flowers spawn in patch regions, with local per-column randomness.
-          float flower_patch = valueNoise2D(
-            x, z, WORLDGEN_FLOWER_PATCH_SCALE, 0x91BD3EF0762CA845ULL
-          );
-          if (
-            flower_patch > ((float)WORLDGEN_FLOWER_PATCH_THRESHOLD / 100.0f) &&
-            deco < flowers_plain_chance
-          ) return getFlowerBlockFromHash(getCoordinateHash(x, 1, z), W_plains);
-
-          if (deco < mushrooms_plain_chance) {
-            return ((getCoordinateHash(x, 5, z) & 1) == 0) ? B_brown_mushroom : B_red_mushroom;
-          }
-
-          if (deco < scaleChanceU8(WORLDGEN_PLAINS_GRASS_CHANCE, WORLDGEN_DECOR_DENSITY_SCALE)) {
-            if (deco_hi < 84) return B_fern;
-            return B_short_grass;
-          }
-        }
-      } else if (anchor.biome == W_desert) {
-        if (deco < scaleChanceU8(WORLDGEN_DESERT_DEAD_BUSH_CHANCE, WORLDGEN_DECOR_DENSITY_SCALE)) return B_dead_bush;
-      } else if (anchor.biome == W_mangrove_swamp) {
-        if (deco < mushrooms_swamp_chance && y > 64) {
-          return ((getCoordinateHash(x, 8, z) & 1) == 0) ? B_brown_mushroom : B_red_mushroom;
-        }
-        if (deco < scaleChanceU8((uint8_t)(WORLDGEN_SWAMP_GRASS_CHANCE / 2), WORLDGEN_DECOR_DENSITY_SCALE) && y > 64) return B_fern;
-        if (deco < scaleChanceU8(WORLDGEN_SWAMP_GRASS_CHANCE, WORLDGEN_DECOR_DENSITY_SCALE) && y > 64) return B_short_grass;
-      }
-    }
-    if (anchor.biome == W_snowy_plains && y == height + 1) {
-      return B_snow;
-    }
+    if (y == height) return column->surface;
+    if (y == height + 1) return column->cover;
   }
   // Starting at 4 blocks below terrain level, generate minerals and caves
   if (y <= height - 4) {
     // Coherent cave field + aquifer/lava fluid fill.
-    if (isCaveOpenAt(x, y, z, height)) {
-      uint8_t fluid = getAquiferFluidAt(x, y, z);
-      if (fluid != B_air) return fluid;
-      return B_air;
+    if (isCaveOpenAt(x, y, z, height, column->cave_roughness)) {
+      return getAquiferFluidAt(y, column->aquifer_level);
     }
 
     // The chunk-relative X and Z coordinates are used as the seed for an
@@ -988,13 +1441,13 @@ uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor
   }
   // Handle the space between stone and grass
   if (y <= height) {
-    if (anchor.biome == W_desert) return B_sandstone;
-    if (anchor.biome == W_mangrove_swamp) return B_mud;
-    if (anchor.biome == W_beach && height > 64) return B_sandstone;
+    if (biome == W_desert) return B_sandstone;
+    if (biome == W_mangrove_swamp) return B_mud;
+    if (biome == W_beach && height > 64) return B_sandstone;
     return B_dirt;
   }
   // If all else failed, but we're below sea level, generate water (or ice)
-  if (y == 63 && anchor.biome == W_snowy_plains) return B_ice;
+  if (y == 63 && biome == W_snowy_plains) return B_ice;
   if (y < 64) return B_water;
 
   // For everything else, fall back to air
@@ -1002,6 +1455,42 @@ uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor
 
 }
 
+// Terrain generator specialized for one biome, see getBiomeTerrainAt
+typedef uint8_t (*TerrainKernel) (int x, int y, int z, int rx, int rz, ChunkAnchor anchor, ChunkFeature feature, const ChunkColumn *column, const ChunkPlacements *placements);
+
+#define DEFINE_TERRAIN_KERNEL(name, biome) \
+  static uint8_t name (int x, int y, int z, int rx, int rz, ChunkAnchor anchor, ChunkFeature feature, const ChunkColumn *column, const ChunkPlacements *placements) { \
+    return getBiomeTerrainAt(x, y, z, rx, rz, anchor, feature, column, placements, biome); \
+  }
+
+DEFINE_TERRAIN_KERNEL(getPlainsTerrainAt, W_plains)
+DEFINE_TERRAIN_KERNEL(getDesertTerrainAt, W_desert)
+DEFINE_TERRAIN_KERNEL(getSnowyPlainsTerrainAt, W_snowy_plains)
+DEFINE_TERRAIN_KERNEL(getMangroveSwampTerrainAt, W_mangrove_swamp)
+DEFINE_TERRAIN_KERNEL(getBeachTerrainAt, W_beach)
+// Any other biome, checked block by block
+DEFINE_TERRAIN_KERNEL(getOtherTerrainAt, anchor.biome)
+
+// Returns the terrain generator for minichunks of biome `biome`.
+// Callers look this up once per minichunk rather than once per block.
+static TerrainKernel getTerrainKernel (uint8_t biome) {
+  switch (biome) {
+    case W_plains: return getPlainsTerrainAt;
+    case W_desert: return getDesertTerrainAt;
+    case W_snowy_plains: return getSnowyPlainsTerrainAt;
+    case W_mangrove_swamp: return getMangroveSwampTerrainAt;
+    case W_beach: return getBeachTerrainAt;
+    default: return getOtherTerrainAt;
+  }
+}
+
+// Returns the terrain block at (x, y, z), given the anchor and feature of
+// its minichunk, the precomputed decisions about its column and the
+// placements reaching into it
+uint8_t getTerrainAtFromCache (int x, int y, int z, int rx, int rz, ChunkAnchor anchor, ChunkFeature feature, const ChunkColumn *column, const ChunkPlacements *placements) {
+  return getTerrainKernel(anchor.biome)(x, y, z, rx, rz, anchor, feature, column, placements);
+}
+
 ChunkFeature getFeatureFromAnchor (ChunkAnchor anchor) {
 
   ChunkFeature feature;
@@ -1024,9 +1513,9 @@ ChunkFeature getFeatureFromAnchor (ChunkAnchor anchor) {
   } else {
     feature.x += anchor.x * CHUNK_SIZE;
     feature.z += anchor.z * CHUNK_SIZE;
-    feature.y = getHeightAtFromHash(
+    feature.y = getHeightAtFromAnchor(
       mod_abs(feature.x, CHUNK_SIZE), mod_abs(feature.z, CHUNK_SIZE),
-      anchor.x, anchor.z, anchor.hash, anchor.biome
+      anchor.x, anchor.z, anchor.biome
     ) + 1;
 
     // Tree placement rules: biome-specific chance plus grove clustering.
@@ -1090,9 +1579,24 @@ uint8_t getTerrainAt (int x, int y, int z, ChunkAnchor anchor) {
   if (rz < 0) rz += CHUNK_SIZE;
 
   ChunkFeature feature = getFeatureFromAnchor(anchor);
-  uint8_t height = getHeightAtFromHash(rx, rz, anchor.x, anchor.z, anchor.hash, anchor.biome);
+  uint8_t height = getHeightAtFromAnchor(rx, rz, anchor.x, anchor.z, anchor.biome);
+
+  // Surface decisions are only needed near the surface
+  ChunkColumn column;
+  uint8_t near_surface = y >= (int)height - 3 && y <= (int)height + 1;
+  uint8_t h_min = 0, h_max = 0;
+  float river_mask = 0.0f;
+  if (near_surface) {
+    getNeighborHeightRange(x, z, &h_min, &h_max);
+    river_mask = getRiverChannelMask(x, z);
+  }
+  ChunkPlacements *placements = &worldgen_context->column_placements;
+  findChunkPlacements(placements, x, z, x, z);
+  initChunkColumn(&column, x, z, anchor, placements, height, h_min, h_max, river_mask, near_surface);
+  column.cave_roughness = getCaveRoughness(x, z);
+  column.aquifer_level = getAquiferLevel(x, z);
 
-  return getTerrainAtFromCache(x, y, z, rx, rz, anchor, feature, height);
+  return getTerrainAtFromCache(x, y, z, rx, rz, anchor, feature, &column, placements);
 
 }
 
@@ -1124,12 +1628,137 @@ static uint8_t getNetherTerrainAt (int x, int y, int z) {
 
 }
 
+typedef struct {
+  short x;
+  short z;
+  int8_t y;
+  uint8_t valid;
+  uint32_t last_use;
+  // Blocks in the layout of buildChunkSection, block changes applied
+  uint8_t blocks[4096];
+} CachedBlockSection;
+
+// Sections of final blocks that getBlockAt is often asked about.
+// Only the main thread may use these, as they include block changes.
+static CachedBlockSection block_cache[BLOCK_CACHE_SIZE];
+static uint32_t block_cache_clock = 0;
+static int block_cache_last = 0;
+
+// Sections that missed the cache, with the number of misses. Building
+// a section costs about as much as a few hundred warm single-block
+// lookups, so only sections that keep missing are built and cached.
+#define BLOCK_CACHE_CANDIDATES 16
+#define BLOCK_CACHE_ADMIT_MISSES 256
+static struct {
+  short x;
+  short z;
+  int8_t y;
+  uint16_t misses;
+} block_cache_candidates[BLOCK_CACHE_CANDIDATES];
+static int block_cache_candidate_next = 0;
+
+static CachedBlockSection *findCachedBlockSection (short section_x, int8_t section_y, short section_z) {
+  CachedBlockSection *cached = &block_cache[block_cache_last];
+  if (cached->valid && cached->x == section_x && cached->y == section_y && cached->z == section_z) return cached;
+  for (int i = 0; i < BLOCK_CACHE_SIZE; i ++) {
+    cached = &block_cache[i];
+    if (!cached->valid) continue;
+    if (cached->x != section_x || cached->y != section_y || cached->z != section_z) continue;
+    block_cache_last = i;
+    return cached;
+  }
+  return NULL;
+}
+
+// Builds the section at (section_x, section_y, section_z) into the
+// least recently used cache entry. Main thread only.
+static CachedBlockSection *cacheBlockSection (short section_x, int8_t section_y, short section_z) {
+  int victim = 0;
+  for (int i = 0; i < BLOCK_CACHE_SIZE; i ++) {
+    if (!block_cache[i].valid) {
+      victim = i;
+      break;
+    }
+    if (block_cache[i].last_use < block_cache[victim].last_use) victim = i;
+  }
+
+  buildChunkSection(section_x * 16, section_y * 16, section_z * 16);
+  CachedBlockSection *cached = &block_cache[victim];
+  cached->x = section_x;
+  cached->y = section_y;
+  cached->z = section_z;
+  cached->valid = true;
+  memcpy(cached->blocks, worldgen_context->section, 4096);
+  return cached;
+}
+
+// Returns the cached blocks of the section holding (x, y, z), or NULL
+// if the block should be looked up on its own. Main thread only.
+static uint8_t *getCachedBlockSection (int x, int y, int z) {
+  short section_x = div_floor(x, 16);
+  short section_z = div_floor(z, 16);
+  int8_t section_y = y / 16;
+
+  CachedBlockSection *cached = findCachedBlockSection(section_x, section_y, section_z);
+  if (cached == NULL) {
+    int candidate = -1;
+    for (int i = 0; i < BLOCK_CACHE_CANDIDATES; i ++) {
+      if (block_cache_candidates[i].misses == 0) continue;
+      if (block_cache_candidates[i].x != section_x) continue;
+      if (block_cache_candidates[i].y != section_y) continue;
+      if (block_cache_candidates[i].z != section_z) continue;
+      candidate = i;
+      break;
+    }
+    if (candidate == -1) {
+      candidate = block_cache_candidate_next;
+      block_cache_candidate_next = (block_cache_candidate_next + 1) % BLOCK_CACHE_CANDIDATES;
+      block_cache_candidates[candidate].x = section_x;
+      block_cache_candidates[candidate].y = section_y;
+      block_cache_candidates[candidate].z = section_z;
+      block_cache_candidates[candidate].misses = 0;
+    }
+    if (++ block_cache_candidates[candidate].misses < BLOCK_CACHE_ADMIT_MISSES) return NULL;
+    block_cache_candidates[candidate].misses = 0;
+    cached = cacheBlockSection(section_x, section_y, section_z);
+  }
+
+  cached->last_use = ++ block_cache_clock;
+  return cached->blocks;
+}
+
+// Keeps the block cache in step with a block change at (x, y, z)
+void updateBlockCache (short x, uint8_t y, short z, uint8_t block) {
+  CachedBlockSection *cached = findCachedBlockSection(div_floor(x, 16), y / 16, div_floor(z, 16));
+  if (cached == NULL) return;
+  unsigned address = (unsigned)((x & 15) + ((z & 15) << 4) + ((y & 15) << 8));
+  cached->blocks[getSectionBlockIndex(address)] = block;
+}
+
+// Drops all cached sections, for when block changes are replaced in bulk
+void clearBlockCache () {
+  for (int i = 0; i < BLOCK_CACHE_SIZE; i ++) block_cache[i].valid = false;
+  for (int i = 0; i < BLOCK_CACHE_CANDIDATES; i ++) block_cache_candidates[i].misses = 0;
+}
+
 uint8_t getBlockAt (int x, int y, int z) {
 
   if (y < 0) return B_bedrock;
 
-  uint8_t block_change = getBlockChange(x, y, z);
-  if (block_change != 0xFF) return block_change;
+  // Block changes may only be read by the main thread
+  if (!worldgen_context->terrain_only) {
+    // Block changes only reach up to y = 255, and nether sections
+    // are built without them, so neither is cached
+    if (y < 256 && !isNetherZone(z)) {
+      uint8_t *blocks = getCachedBlockSection(x, y, z);
+      if (blocks != NULL) {
+        unsigned address = (unsigned)((x & 15) + ((z & 15) << 4) + ((y & 15) << 8));
+        return blocks[getSectionBlockIndex(address)];
+      }
+    }
+    uint8_t block_change = getBlockChange(x, y, z);
+    if (block_change != 0xFF) return block_change;
+  }
 
   if (isNetherZone(z)) return getNetherTerrainAt(x, y, z);
 
@@ -1146,29 +1775,19 @@ uint8_t getBlockAt (int x, int y, int z) {
 
 }
 
-uint8_t chunk_section[4096];
-ChunkAnchor chunk_anchors[(16 / CHUNK_SIZE + 1) * (16 / CHUNK_SIZE + 1)];
-ChunkFeature chunk_features[256 / (CHUNK_SIZE * CHUNK_SIZE)];
-uint8_t chunk_section_height[16][16];
+/**
+ * Prepares the anchors, features and column decisions of the chunk
+ * whose origin block is (cx, cz) in `context`, shared by all sections
+ * that buildChunkSection generates for that chunk.
+ */
+static void prepareChunkColumns (WorldgenContext *context, int cx, int cz) {
 
-// Builds a 16x16x16 chunk of blocks and writes it to `chunk_section`
-// Returns the biome at the origin corner of the chunk
-uint8_t buildChunkSection (int cx, int cy, int cz) {
-
-  if (isNetherZone(cz)) {
-    for (int j = 0; j < 4096; j += 8) {
-      int y = j / 256 + cy;
-      int rz = j / 16 % 16;
-      for (int offset = 7; offset >= 0; offset--) {
-        int k = j + offset;
-        int rx = k % 16;
-        chunk_section[j + 7 - offset] = getNetherTerrainAt(rx + cx, y, rz + cz);
-      }
-    }
-    return W_desert;
-  }
+  ChunkAnchor *chunk_anchors = context->anchors;
+  ChunkFeature *chunk_features = context->features;
+  ChunkColumn *columns = context->columns;
 
   // Precompute hashes, anchors and features for each relevant minichunk
+  PROFILE_BEGIN(anchors_start);
   int anchor_index = 0, feature_index = 0;
   for (int i = cz; i < cz + 16 + CHUNK_SIZE; i += CHUNK_SIZE) {
     for (int j = cx; j < cx + 16 + CHUNK_SIZE; j += CHUNK_SIZE) {
@@ -1190,55 +1809,161 @@ uint8_t buildChunkSection (int cx, int cy, int cz) {
     }
   }
 
-  // Precompute terrain height for entire chunk section
-  for (int i = 0; i < 16; i ++) {
-    for (int j = 0; j < 16; j ++) {
-      anchor_index = (j / CHUNK_SIZE) + (i / CHUNK_SIZE) * (16 / CHUNK_SIZE + 1);
-      ChunkAnchor *anchor_ptr = chunk_anchors + anchor_index;
-      chunk_section_height[j][i] = getHeightAtFromAnchors(j % CHUNK_SIZE, i % CHUNK_SIZE, anchor_ptr);
+  PROFILE_END(context, WORLDGEN_STAGE_ANCHORS, anchors_start);
+  PROFILE_BEGIN(heights_start);
+
+  context->columns_air_top = 0;
+
+  // Terrain height of the chunk and the ring of columns around it,
+  // which slopes are measured against. Indexed by [dz + 1][dx + 1].
+  uint8_t heights[18][18];
+  for (int dz = -1; dz <= 16; dz ++) {
+    for (int dx = -1; dx <= 16; dx ++) {
+      if (dx >= 0 && dx < 16 && dz >= 0 && dz < 16) {
+        anchor_index = (dx / CHUNK_SIZE) + (dz / CHUNK_SIZE) * (16 / CHUNK_SIZE + 1);
+        heights[dz + 1][dx + 1] = getHeightAtFromAnchors(dx % CHUNK_SIZE, dz % CHUNK_SIZE, chunk_anchors + anchor_index);
+      } else if ((dx >= 0 && dx < 16) || (dz >= 0 && dz < 16)) {
+        heights[dz + 1][dx + 1] = getHeightAt(cx + dx, cz + dz);
+      }
     }
   }
 
-  // Generate 4096 blocks in one buffer to reduce overhead
-  for (int j = 0; j < 4096; j += 8) {
-    // These values don't change in the lower array,
-    // Since all of the operations are on multiples of 8
-    int y = j / 256 + cy;
-    int rz = j / 16 % 16;
-    int rz_mod = rz % CHUNK_SIZE;
-    feature_index = (j % 16) / CHUNK_SIZE + (j / 16 % 16) / CHUNK_SIZE * (16 / CHUNK_SIZE);
-    anchor_index = (j % 16) / CHUNK_SIZE + (j / 16 % 16) / CHUNK_SIZE * (16 / CHUNK_SIZE + 1);
-    // The client expects "big-endian longs", which in our
-    // Case means reversing the order in which we store/send
-    // Each 8 block sequence.
-    for (int offset = 7; offset >= 0; offset--) {
-      int k = j + offset;
-      int rx = k % 16;
-      // Combine all of the cached data to retrieve the block
-      chunk_section[j + 7 - offset] = getTerrainAtFromCache(
-        rx + cx, y, rz + cz,
-        rx % CHUNK_SIZE, rz_mod,
-        chunk_anchors[anchor_index],
-        chunk_features[feature_index],
-        chunk_section_height[rx][rz]
-      );
+  // Structures and surface features are placed once for the whole chunk
+  findChunkPlacements(&context->placements, cx, cz, cx + 15, cz + 15);
+
+  float *river_mask = context->noise_grid[0];
+  getRiverChannelMaskGrid(cx, cz, river_mask, context->noise_grid[1]);
+  for (int dz = 0; dz < 16; dz ++) {
+    for (int dx = 0; dx < 16; dx ++) {
+      int x = cx + dx, z = cz + dz;
+      ChunkAnchor anchor = chunk_anchors[(dx / CHUNK_SIZE) + (dz / CHUNK_SIZE) * (16 / CHUNK_SIZE + 1)];
+      uint8_t h_n = heights[dz][dx + 1];
+      uint8_t h_s = heights[dz + 2][dx + 1];
+      uint8_t h_w = heights[dz + 1][dx];
+      uint8_t h_e = heights[dz + 1][dx + 2];
+      uint8_t h_min = h_n, h_max = h_n;
+      if (h_s < h_min) h_min = h_s;
+      if (h_w < h_min) h_min = h_w;
+      if (h_e < h_min) h_min = h_e;
+      if (h_s > h_max) h_max = h_s;
+      if (h_w > h_max) h_max = h_w;
+      if (h_e > h_max) h_max = h_e;
+
+      ChunkColumn *column = &columns[dx + dz * 16];
+      initChunkColumn(column, x, z, anchor, &context->placements, heights[dz + 1][dx + 1], h_min, h_max, river_mask[dx + dz * 16], true);
+
+      ChunkFeature feature = chunk_features[(dx / CHUNK_SIZE) + (dz / CHUNK_SIZE) * (16 / CHUNK_SIZE)];
+      column->air_top = getColumnAirTop(column, feature);
+      if (column->air_top > context->columns_air_top) context->columns_air_top = column->air_top;
+    }
+  }
+
+  float *noise = context->noise_grid[0];
+  getCaveRoughnessGrid(cx, cz, noise);
+  for (int i = 0; i < 256; i ++) columns[i].cave_roughness = noise[i];
+  getAquiferNoiseGrid(cx, cz, noise);
+  for (int i = 0; i < 256; i ++) columns[i].aquifer_level = getAquiferLevelFromNoise(noise[i]);
+  PROFILE_END(context, WORLDGEN_STAGE_HEIGHTS, heights_start);
+
+  context->columns_x = cx;
+  context->columns_z = cz;
+  context->columns_ready = true;
+
+}
+
+// Builds a 16x16x16 chunk of blocks and writes it to the `section` of
+// the calling thread's worldgen context
+// Returns the biome at the origin corner of the chunk
+uint8_t buildChunkSection (int cx, int cy, int cz) {
+
+  WorldgenContext *context = worldgen_context;
+  uint8_t *chunk_section = context->section;
+  ChunkAnchor *chunk_anchors = context->anchors;
+  ChunkFeature *chunk_features = context->features;
+
+  if (isNetherZone(cz)) {
+    PROFILE_BEGIN(nether_start);
+    for (int j = 0; j < 4096; j += 8) {
+      int y = j / 256 + cy;
+      int rz = j / 16 % 16;
+      for (int offset = 7; offset >= 0; offset--) {
+        int k = j + offset;
+        int rx = k % 16;
+        chunk_section[j + 7 - offset] = getNetherTerrainAt(rx + cx, y, rz + cz);
+      }
+    }
+    PROFILE_END(context, WORLDGEN_STAGE_TERRAIN, nether_start);
+    return W_desert;
+  }
+
+  // Everything that does not depend on y is worked out once per chunk
+  if (!context->columns_ready || context->columns_x != cx || context->columns_z != cz) {
+    prepareChunkColumns(context, cx, cz);
+  }
+  PROFILE_BEGIN(terrain_start);
+
+  // Skip sections that are uniform by construction: nothing but air
+  // above every column's air_top, and nothing but stone below y = 0,
+  // where there are neither caves (y <= 1) nor ores (y 0 to 63).
+  // There is no band of plain stone and ores between y = 0 and the
+  // surface to skip as well: the lattice points any section reads from
+  // there dip below the cave threshold of its deepest block in all but a
+  // handful of sections, so the kernels still carve it block by block.
+  if (cy > context->columns_air_top) {
+    memset(chunk_section, B_air, 4096);
+  } else if (cy + 16 <= 0) {
+    memset(chunk_section, B_stone, 4096);
+  } else {
+    // Pick the terrain generator of each minichunk once
+    TerrainKernel kernels[(16 / CHUNK_SIZE + 1) * (16 / CHUNK_SIZE + 1)];
+    for (int i = 0; i < (16 / CHUNK_SIZE + 1) * (16 / CHUNK_SIZE + 1); i ++) {
+      kernels[i] = getTerrainKernel(chunk_anchors[i].biome);
+    }
+    // Generate 4096 blocks in one buffer to reduce overhead
+    for (int j = 0; j < 4096; j += 8) {
+      // These values don't change in the lower array,
+      // Since all of the operations are on multiples of 8
+      int y = j / 256 + cy;
+      int rz = j / 16 % 16;
+      int rz_mod = rz % CHUNK_SIZE;
+      int feature_index = (j % 16) / CHUNK_SIZE + (j / 16 % 16) / CHUNK_SIZE * (16 / CHUNK_SIZE);
+      int anchor_index = (j % 16) / CHUNK_SIZE + (j / 16 % 16) / CHUNK_SIZE * (16 / CHUNK_SIZE + 1);
+      TerrainKernel kernel = kernels[anchor_index];
+      // The client expects "big-endian longs", which in our
+      // Case means reversing the order in which we store/send
+      // Each 8 block sequence.
+      for (int offset = 7; offset >= 0; offset--) {
+        int k = j + offset;
+        int rx = k % 16;
+        ChunkColumn *column = &context->columns[rx + rz * 16];
+        if (y > column->air_top) {
+          chunk_section[j + 7 - offset] = B_air;
+          continue;
+        }
+        // Combine all of the cached data to retrieve the block
+        chunk_section[j + 7 - offset] = kernel(
+          rx + cx, y, rz + cz,
+          rx % CHUNK_SIZE, rz_mod,
+          chunk_anchors[anchor_index],
+          chunk_features[feature_index],
+          column, &context->placements
+        );
+      }
     }
   }
+  PROFILE_END(context, WORLDGEN_STAGE_TERRAIN, terrain_start);
 
   // Apply block changes on top of terrain
   // This does mean that we're generating some terrain only to replace it,
   // But it's better to apply changes in one run rather than in individual
   // Runs per block, as this is more expensive than terrain generation.
+  if (context->terrain_only) return chunk_anchors[0].biome;
+  PROFILE_BEGIN(changes_start);
   short chunk_x = div_floor(cx, 16);
   short chunk_z = div_floor(cz, 16);
   for (int i = firstBlockChangeInChunk(chunk_x, chunk_z); i != -1; i = nextIndexedBlockChange(i)) {
     if (div_floor(block_changes[i].x, 16) != chunk_x) continue;
     if (div_floor(block_changes[i].z, 16) != chunk_z) continue;
-    // Skip blocks that behave better when sent using a block update
-    if (block_changes[i].block == B_torch) continue;
-    #ifdef ALLOW_CHESTS
-      if (block_changes[i].block == B_chest) continue;
-    #endif
     if (block_changes[i].y >= cy && block_changes[i].y < cy + 16) {
       int dx = block_changes[i].x - cx;
       int dy = block_changes[i].y - cy;
@@ -1250,7 +1975,273 @@ uint8_t buildChunkSection (int cx, int cy, int cz) {
       chunk_section[index] = block_changes[i].block;
     }
   }
+  PROFILE_END(context, WORLDGEN_STAGE_CHANGES, changes_start);
 
   return chunk_anchors[0].biome;
 
 }
+
+/**
+ * Returns false if the terrain of the section at block (x, y, z) is
+ * certain to hold no light emitters, true if it may hold some. Natural
+ * lava only fills caves below y = 8 and ore pockets below y = 5, tops
+ * surface lava pools at y = 63 to 98, and spills from ruined portals at
+ * their base. The nether zone holds lava throughout.
+ */
+uint8_t mayTerrainEmitLight (int x, int y, int z) {
+  if (isNetherZone(z)) return true;
+  if (y + 15 >= 0 && y < 8) return true;
+  if (y + 15 < 60 || y > 116) return false;
+
+  ChunkPlacements placements;
+  findChunkPlacements(&placements, x, z, x + 15, z + 15);
+  for (int i = 0; i < placements.count; i ++) {
+    const Placement *placement = &placements.list[i];
+    if (placement->type == PLACEMENT_LAVA_POOL && y <= 98) return true;
+    if (placement->type == PLACEMENT_RUINED_PORTAL && placement->y >= y && placement->y < y + 16) return true;
+  }
+  return false;
+}
+
+typedef struct {
+  short x;
+  short z;
+  uint8_t valid;
+  uint32_t last_use;
+  // Per column, indexed x + z * 16, as described by ColumnSummary
+  uint8_t height[256];
+  uint8_t slope[256];
+  uint8_t top_solid[256];
+  // One bit per column: whether its terrain and its blocks have been
+  // summarized yet, then one for each of the COLUMN_* surface flags
+  uint8_t terrain_ready[32];
+  uint8_t blocks_ready[32];
+  uint8_t spawnable[32];
+  uint8_t dry_land[32];
+  uint8_t wet[32];
+} ChunkSummary;
+
+// Column summaries of recently inspected chunks, each worked out when
+// first asked about.
+// Only the main thread may use these, as they include block changes.
+static ChunkSummary chunk_summaries[CHUNK_SUMMARY_CACHE_SIZE];
+static uint32_t chunk_summary_clock = 0;
+static int chunk_summary_last = 0;
+
+static void setSummaryBit (uint8_t *bits, int column, uint8_t value) {
+  if (value) bits[column >> 3] |= (uint8_t)(1 << (column & 7));
+  else bits[column >> 3] &= (uint8_t)~(1 << (column & 7));
+}
+
+static uint8_t getSummaryBit (const uint8_t *bits, int column) {
+  return (bits[column >> 3] >> (column & 7)) & 1;
+}
+
+// Classifies the surface of a column of terrain height `height` from the
+// blocks at that height (`surface`) and right above it (`cover`)
+static uint8_t getSurfaceFlags (uint8_t height, uint8_t surface, uint8_t cover) {
+  if (!isPassableBlock(surface) && cover == B_air && height >= 63) return COLUMN_DRY_LAND;
+  if (cover == B_water || surface == B_water) return COLUMN_WET;
+  return 0;
+}
+
+static ChunkSummary *findChunkSummary (short chunk_x, short chunk_z) {
+  ChunkSummary *summary = &chunk_summaries[chunk_summary_last];
+  if (summary->valid && summary->x == chunk_x && summary->z == chunk_z) return summary;
+  for (int i = 0; i < CHUNK_SUMMARY_CACHE_SIZE; i ++) {
+    summary = &chunk_summaries[i];
+    if (!summary->valid || summary->x != chunk_x || summary->z != chunk_z) continue;
+    chunk_summary_last = i;
+    return summary;
+  }
+  return NULL;
+}
+
+// Looks up the slope at (x, z) in an existing chunk summary, without
+// summarizing anything. Returns false if there is none to look in.
+static uint8_t findSummarizedSlope (int x, int z, uint8_t *slope) {
+  if (worldgen_context->terrain_only) return false;
+  ChunkSummary *summary = findChunkSummary(div_floor(x, 16), div_floor(z, 16));
+  if (summary == NULL) return false;
+  int index = (x & 15) + ((z & 15) << 4);
+  if (!getSummaryBit(summary->terrain_ready, index)) return false;
+  *slope = summary->slope[index];
+  return true;
+}
+
+// Fills in the terrain height and slope of column `index` of `summary`
+static void summarizeColumnTerrain (ChunkSummary *summary, int index) {
+  int x = summary->x * 16 + (index & 15);
+  int z = summary->z * 16 + (index >> 4);
+  uint8_t h_min, h_max;
+  getNeighborHeightRange(x, z, &h_min, &h_max);
+  summary->height[index] = getHeightAt(x, z);
+  summary->slope[index] = h_max - h_min;
+  setSummaryBit(summary->terrain_ready, index, true);
+}
+
+/**
+ * Fills in the top solid block and surface flags of column `index` of
+ * `summary` from its final blocks. The column is prepared on its own, as
+ * prepareChunkColumns would, and walked down from the highest block that
+ * can be anything but air to its top solid block and terrain surface.
+ */
+static void summarizeColumnBlocks (ChunkSummary *summary, int index) {
+  int dx = index & 15, dz = index >> 4;
+  int x = summary->x * 16 + dx;
+  int z = summary->z * 16 + dz;
+  uint8_t height = summary->height[index];
+
+  short anchor_x = div_floor(x, CHUNK_SIZE);
+  short anchor_z = div_floor(z, CHUNK_SIZE);
+  ChunkAnchor anchor = {
+    .x = anchor_x,
+    .z = anchor_z,
+    .hash = getChunkHash(anchor_x, anchor_z),
+    .biome = getChunkBiome(anchor_x, anchor_z)
+  };
+  ChunkFeature feature = getFeatureFromAnchor(anchor);
+
+  ChunkColumn column;
+  uint8_t h_min, h_max;
+  ChunkPlacements *placements = &worldgen_context->column_placements;
+  findChunkPlacements(placements, x, z, x, z);
+  getNeighborHeightRange(x, z, &h_min, &h_max);
+  initChunkColumn(&column, x, z, anchor, placements, height, h_min, h_max, getRiverChannelMask(x, z), true);
+  column.cave_roughness = getCaveRoughness(x, z);
+  column.aquifer_level = getAquiferLevel(x, z);
+  column.air_top = getColumnAirTop(&column, feature);
+
+  // Block changes may reach above air_top
+  int change_top = -1;
+  for (int i = firstBlockChangeInChunk(summary->x, summary->z); i != -1; i = nextIndexedBlockChange(i)) {
+    if (block_changes[i].x != x || block_changes[i].z != z) continue;
+    if (block_changes[i].y > change_top) change_top = block_changes[i].y;
+  }
+
+  // The two blocks above the one being looked at
+  uint8_t above[2] = { B_air, B_air };
+  uint8_t found = false;
+  summary->top_solid[index] = 0;
+  setSummaryBit(summary->spawnable, index, false);
+  TerrainKernel kernel = getTerrainKernel(anchor.biome);
+  int y = column.air_top > change_top ? column.air_top : change_top;
+  for (; y >= 0 && (!found || y >= height); y --) {
+    uint8_t block = B_air;
+    if (y <= column.air_top) {
+      block = kernel(x, y, z, mod_abs(x, CHUNK_SIZE), mod_abs(z, CHUNK_SIZE), anchor, feature, &column, placements);
+    }
+    if (y <= change_top) {
+      uint8_t block_change = getBlockChange(x, y, z);
+      if (block_change != 0xFF) block = block_change;
+    }
+
+    if (y == height) {
+      uint8_t flags = getSurfaceFlags(height, block, above[0]);
+      setSummaryBit(summary->dry_land, index, flags & COLUMN_DRY_LAND);
+      setSummaryBit(summary->wet, index, flags & COLUMN_WET);
+    }
+    if (!found && !isPassableBlock(block)) {
+      found = true;
+      summary->top_solid[index] = (uint8_t)y;
+      setSummaryBit(summary->spawnable, index,
+        isPassableSpawnBlock(above[0]) && isPassableSpawnBlock(above[1])
+      );
+    }
+    above[1] = above[0];
+    above[0] = block;
+  }
+
+  setSummaryBit(summary->blocks_ready, index, true);
+}
+
+// Returns the summary of chunk (chunk_x, chunk_z), taking over the least
+// recently used entry if needed. Main thread only.
+static ChunkSummary *getChunkSummary (short chunk_x, short chunk_z) {
+  ChunkSummary *summary = findChunkSummary(chunk_x, chunk_z);
+  if (summary == NULL) {
+    int victim = 0;
+    for (int i = 0; i < CHUNK_SUMMARY_CACHE_SIZE; i ++) {
+      if (!chunk_summaries[i].valid) {
+        victim = i;
+        break;
+      }
+      if (chunk_summaries[i].last_use < chunk_summaries[victim].last_use) victim = i;
+    }
+    summary = &chunk_summaries[victim];
+    summary->x = chunk_x;
+    summary->z = chunk_z;
+    summary->valid = true;
+    memset(summary->terrain_ready, 0, sizeof(summary->terrain_ready));
+    memset(summary->blocks_ready, 0, sizeof(summary->blocks_ready));
+    chunk_summary_last = victim;
+  }
+  summary->last_use = ++ chunk_summary_clock;
+  return summary;
+}
+
+/**
+ * Looks up the summary of column (x, z), summarizing the column first if
+ * needed. Only height and slope are filled in unless `with_blocks` is
+ * set, which walks the column's blocks the first time it is asked for.
+ * Returns false if there is no summary to be had, that is, off the main
+ * thread or in the nether zone.
+ */
+uint8_t getColumnSummary (int x, int z, uint8_t with_blocks, ColumnSummary *column) {
+  if (worldgen_context->terrain_only || isNetherZone(z)) return false;
+
+  ChunkSummary *summary = getChunkSummary(div_floor(x, 16), div_floor(z, 16));
+  int index = (x & 15) + ((z & 15) << 4);
+  if (!getSummaryBit(summary->terrain_ready, index)) summarizeColumnTerrain(summary, index);
+  column->height = summary->height[index];
+  column->slope = summary->slope[index];
+  column->top_solid = 0;
+  column->flags = 0;
+  if (!with_blocks) return true;
+
+  if (!getSummaryBit(summary->blocks_ready, index)) summarizeColumnBlocks(summary, index);
+  column->top_solid = summary->top_solid[index];
+  if (getSummaryBit(summary->spawnable, index)) column->flags |= COLUMN_SPAWNABLE;
+  if (getSummaryBit(summary->dry_land, index)) column->flags |= COLUMN_DRY_LAND;
+  if (getSummaryBit(summary->wet, index)) column->flags |= COLUMN_WET;
+  return true;
+}
+
+// Keeps the chunk summaries in step with a block change at (x, y, z),
+// after the change has been stored
+void updateChunkSummary (short x, uint8_t y, short z, uint8_t block) {
+  ChunkSummary *summary = findChunkSummary(div_floor(x, 16), div_floor(z, 16));
+  if (summary == NULL) return;
+  int column = (x & 15) + ((z & 15) << 4);
+  // Columns not summarized yet will see the change when they are
+  if (!getSummaryBit(summary->blocks_ready, column)) return;
+
+  uint8_t top = summary->top_solid[column];
+  uint8_t old_top = top;
+  if (!isPassableBlock(block) && y > top) {
+    top = y;
+  } else if (y == top && isPassableBlock(block)) {
+    // The top block was cleared, find the next solid one down
+    while (top > 0 && isPassableBlock(getBlockAt(x, top, z))) top --;
+  }
+  summary->top_solid[column] = top;
+
+  if (top != old_top || (y > top && y <= top + 2)) {
+    setSummaryBit(summary->spawnable, column,
+      isPassableSpawnBlock(getBlockAt(x, top + 1, z)) &&
+      isPassableSpawnBlock(getBlockAt(x, top + 2, z))
+    );
+  }
+
+  uint8_t height = summary->height[column];
+  if (y == height || y == height + 1) {
+    uint8_t flags = getSurfaceFlags(height, getBlockAt(x, height, z), getBlockAt(x, height + 1, z));
+    setSummaryBit(summary->dry_land, column, flags & COLUMN_DRY_LAND);
+    setSummaryBit(summary->wet, column, flags & COLUMN_WET);
+  }
+}
+
+// Drops all chunk summaries, for when block changes are replaced in bulk
+void clearChunkSummaries () {
+  for (int i = 0; i < CHUNK_SUMMARY_CACHE_SIZE; i ++) chunk_summaries[i].valid = false;
+}